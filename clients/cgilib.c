@@ -18,11 +18,28 @@
 */
 
 #include <ctype.h>
+#include <dirent.h>
 
 #include "common.h"
+#include "upsclient.h"
 #include "cgilib.h"
 #include "parseconf.h"
 
+/* snapshot cache settings from hosts.conf (CACHE <path> <seconds>) */
+static char	*cachepath = NULL;
+static int	cachettl = 0;
+
+/* snapshots of the variables of a UPS, one per "upsname@host" */
+typedef struct snapshot_s {
+	char	*sys;
+	size_t	numvars;
+	size_t	maxvars;
+	cgivar_t	*vars;
+	struct snapshot_s	*next;
+} snapshot_t;
+
+static snapshot_t	*snaphead = NULL;
+
 static char *unescape(char *buf)
 {
 	size_t	i, buflen;
@@ -154,9 +171,17 @@ static void cgilib_err(const char *errmsg)
 	upslogx(LOG_ERR, "Fatal error in parseconf(ups.conf): %s", errmsg);
 }
 
+void cgicache_conf(const char *path, const char *ttl)
+{
+	free(cachepath);
+	cachepath = xstrdup(path);
+	cachettl = atoi(ttl);
+}
+
 int checkhost(const char *host, char **desc)
 {
 	char	fn[SMALLBUF];
+	int	found = 0;
 	PCONF_CTX_t	ctx;
 
 	if (!host)
@@ -181,22 +206,336 @@ int checkhost(const char *host, char **desc)
 		}
 
 		/* MONITOR <host> <description> */
+		/* CACHE <path> <seconds> */
 		if (ctx.numargs < 3)
 			continue;
 
+		if (!strcmp(ctx.arglist[0], "CACHE")) {
+			cgicache_conf(ctx.arglist[1], ctx.arglist[2]);
+			continue;
+		}
+
 		if (strcmp(ctx.arglist[0], "MONITOR") != 0)
 			continue;
 
-		if (!strcmp(ctx.arglist[1], host)) {
+		/* keep going: CACHE may come after the MONITOR lines */
+		if ((!found) && (!strcmp(ctx.arglist[1], host))) {
 			if (desc)
 				*desc = xstrdup(ctx.arglist[2]);
 
-			pconf_finish(&ctx);
-			return 1;	/* found: allow access */
+			found = 1;	/* found: allow access */
 		}
 	}
 
 	pconf_finish(&ctx);
 
-	return 0;	/* not found: access denied */
-}	
+	return found;
+}
+
+int cgicache_enabled(void)
+{
+	return ((cachepath != NULL) && (cachettl > 0));
+}
+
+const char *cgicache_dir(void)
+{
+	return cachepath;
+}
+
+void cgicache_prune(const char *prefix)
+{
+	char	fn[LARGEBUF];
+	DIR	*dir;
+	struct dirent	*de;
+	struct stat	fs;
+	time_t	now;
+
+	if (!cachepath)
+		return;
+
+	dir = opendir(cachepath);
+
+	if (!dir)
+		return;
+
+	time(&now);
+
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp(de->d_name, prefix, strlen(prefix)) != 0)
+			continue;
+
+		snprintf(fn, sizeof(fn), "%s/%s", cachepath, de->d_name);
+
+		if ((stat(fn, &fs) != 0) || (!S_ISREG(fs.st_mode)))
+			continue;
+
+		if ((now < fs.st_mtime) || (now - fs.st_mtime < cachettl))
+			continue;
+
+		unlink(fn);
+	}
+
+	closedir(dir);
+}
+
+/* build the snapshot file name, without letting <sys> escape cachepath */
+static void cgicache_fn(const char *sys, char *fn, size_t fnlen)
+{
+	char	*ptr;
+
+	snprintf(fn, fnlen, "%s/", cachepath);
+	ptr = fn + strlen(fn);
+
+	snprintfcat(fn, fnlen, "cgicache-%s", sys);
+
+	for (; *ptr; ptr++) {
+		if (*ptr == '/')
+			*ptr = '_';
+	}
+}
+
+static snapshot_t *snapshot_find(const char *sys)
+{
+	snapshot_t	*snap;
+
+	for (snap = snaphead; snap; snap = snap->next) {
+		if (!strcmp(snap->sys, sys))
+			return snap;
+	}
+
+	return NULL;
+}
+
+static void snapshot_clear(snapshot_t *snap)
+{
+	size_t	i;
+
+	for (i = 0; i < snap->numvars; i++) {
+		free(snap->vars[i].name);
+		free(snap->vars[i].value);
+	}
+
+	snap->numvars = 0;
+}
+
+static snapshot_t *snapshot_new(const char *sys)
+{
+	snapshot_t	*snap;
+
+	snap = snapshot_find(sys);
+
+	if (snap) {
+		snapshot_clear(snap);
+		return snap;
+	}
+
+	snap = xcalloc(1, sizeof(*snap));
+	snap->sys = xstrdup(sys);
+	snap->next = snaphead;
+	snaphead = snap;
+
+	return snap;
+}
+
+/* forget a snapshot, so the system isn't seen as fresh anymore */
+static void snapshot_free(snapshot_t *snap)
+{
+	snapshot_t	**prev;
+
+	for (prev = &snaphead; *prev; prev = &(*prev)->next) {
+		if (*prev == snap) {
+			*prev = snap->next;
+			break;
+		}
+	}
+
+	snapshot_clear(snap);
+	free(snap->vars);
+	free(snap->sys);
+	free(snap);
+}
+
+static void snapshot_add(snapshot_t *snap, const char *name, const char *value)
+{
+	if (snap->numvars == snap->maxvars) {
+		snap->maxvars = (snap->maxvars == 0) ? 64 : snap->maxvars * 2;
+		snap->vars = xrealloc(snap->vars, snap->maxvars * sizeof(cgivar_t));
+	}
+
+	snap->vars[snap->numvars].name = xstrdup(name);
+	snap->vars[snap->numvars].value = xstrdup(value);
+	snap->numvars++;
+}
+
+int cgicache_fresh(const char *sys)
+{
+	char	fn[SMALLBUF], buf[LARGEBUF], *sp, *nl;
+	FILE	*f;
+	struct stat	fs;
+	time_t	now;
+	snapshot_t	*snap;
+
+	if (!cgicache_enabled())
+		return 0;
+
+	/* already loaded or refreshed by this process */
+	if (snapshot_find(sys))
+		return 1;
+
+	cgicache_fn(sys, fn, sizeof(fn));
+
+	if (stat(fn, &fs) != 0)
+		return 0;
+
+	time(&now);
+
+	if ((now < fs.st_mtime) || (now - fs.st_mtime >= cachettl))
+		return 0;
+
+	f = fopen(fn, "r");
+
+	if (!f)
+		return 0;
+
+	snap = snapshot_new(sys);
+
+	/* <varname> <value> */
+	while (fgets(buf, sizeof(buf), f)) {
+		nl = strchr(buf, '\n');
+		if (nl)
+			*nl = '\0';
+
+		sp = strchr(buf, ' ');
+		if (!sp)
+			continue;
+
+		*sp++ = '\0';
+		snapshot_add(snap, buf, sp);
+	}
+
+	fclose(f);
+
+	return 1;
+}
+
+void cgicache_clear(const char *sys)
+{
+	snapshot_new(sys);
+}
+
+void cgicache_add(const char *sys, const char *name, const char *value)
+{
+	snapshot_t	*snap;
+
+	snap = snapshot_find(sys);
+
+	if (!snap)
+		snap = snapshot_new(sys);
+
+	snapshot_add(snap, name, value);
+}
+
+void cgicache_save(const char *sys)
+{
+	char	fn[SMALLBUF], tmpfn[LARGEBUF];
+	size_t	i;
+	FILE	*f;
+	snapshot_t	*snap;
+
+	snap = snapshot_find(sys);
+
+	if ((!cgicache_enabled()) || (!snap))
+		return;
+
+	/* share it with the next CGI invocations: write then rename */
+	cgicache_fn(sys, fn, sizeof(fn));
+	snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", fn, (long)getpid());
+
+	f = fopen(tmpfn, "w");
+
+	if (!f) {
+		fprintf(stderr, "Can't create %s: %s\n", tmpfn, strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < snap->numvars; i++)
+		fprintf(f, "%s %s\n", snap->vars[i].name, snap->vars[i].value);
+
+	if ((fclose(f) != 0) || (rename(tmpfn, fn) != 0)) {
+		fprintf(stderr, "Can't update %s: %s\n", fn, strerror(errno));
+		unlink(tmpfn);
+	}
+}
+
+int cgicache_update(const char *sys, UPSCONN_t *ups, const char *upsname)
+{
+	int	ret;
+	unsigned int	numq, numa;
+	const	char	*query[4];
+	char	**answer;
+	snapshot_t	*snap;
+
+	if ((!cgicache_enabled()) || (!upsname))
+		return 0;
+
+	query[0] = "VAR";
+	query[1] = upsname;
+	numq = 2;
+
+	if (upscli_list_start(ups, numq, query) < 0)
+		return 0;
+
+	snap = snapshot_new(sys);
+
+	while ((ret = upscli_list_next(ups, numq, query, &numa, &answer)) == 1) {
+
+		/* VAR <upsname> <varname> <val> */
+		if (numa < 4)
+			continue;
+
+		snapshot_add(snap, answer[2], answer[3]);
+	}
+
+	/* don't share a truncated list */
+	if (ret < 0) {
+		snapshot_free(snap);
+		return 0;
+	}
+
+	cgicache_save(sys);
+
+	return 1;
+}
+
+const char *cgicache_get(const char *sys, const char *var)
+{
+	size_t	i;
+	snapshot_t	*snap;
+
+	snap = snapshot_find(sys);
+
+	if (!snap)
+		return NULL;
+
+	for (i = 0; i < snap->numvars; i++) {
+		if (!strcmp(snap->vars[i].name, var))
+			return snap->vars[i].value;
+	}
+
+	return NULL;
+}
+
+size_t cgicache_vars(const char *sys, const cgivar_t **vars)
+{
+	snapshot_t	*snap;
+
+	snap = snapshot_find(sys);
+
+	if (!snap) {
+		*vars = NULL;
+		return 0;
+	}
+
+	*vars = snap->vars;
+	return snap->numvars;
+}
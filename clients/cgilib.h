@@ -35,6 +35,47 @@ void extractpostargs(void);
 /* see if a host is allowed per the hosts.conf */
 int checkhost(const char *host, char **desc);
 
+/* snapshot cache of UPS variables, shared between CGI invocations so that
+   pages and images drawn within <seconds> don't need to talk to upsd.
+   enabled by "CACHE <path> <seconds>" in hosts.conf */
+
+typedef struct {
+	char	*name;
+	char	*value;
+} cgivar_t;
+
+/* set the cache parameters from a CACHE line in hosts.conf */
+void cgicache_conf(const char *path, const char *ttl);
+
+int cgicache_enabled(void);
+
+/* directory from the CACHE line in hosts.conf, or NULL */
+const char *cgicache_dir(void);
+
+/* remove the files named <prefix>* from the cache directory that were
+   written longer than the CACHE seconds ago */
+void cgicache_prune(const char *prefix);
+
+/* load the snapshot of <sys> (upsname[@hostname[:port]]) if it's recent
+   enough, returns 1 if the snapshot can be used */
+int cgicache_fresh(const char *sys);
+
+/* fetch all variables of <upsname> with a single LIST VAR on <ups> and
+   store them as the snapshot of <sys>, returns 1 on success */
+int cgicache_update(const char *sys, UPSCONN_t *ups, const char *upsname);
+
+/* build the snapshot of <sys> from variables retrieved by the caller,
+   then save it for the next CGI invocations */
+void cgicache_clear(const char *sys);
+void cgicache_add(const char *sys, const char *name, const char *value);
+void cgicache_save(const char *sys);
+
+/* value of <var> in the snapshot of <sys>, NULL if not supported */
+const char *cgicache_get(const char *sys, const char *var);
+
+/* all variables in the snapshot of <sys>, sorted as upsd sent them */
+size_t cgicache_vars(const char *sys, const cgivar_t **vars);
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
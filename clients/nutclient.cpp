@@ -887,6 +887,310 @@ std::string TcpClient::escape(const std::string& str)
 	return res; 
 }
 
+/*
+ *
+ * Caching Client implementation
+ *
+ */
+
+CachingClient::CachingClient(Client* client, long interval):
+Client(),
+_client(client),
+_interval(interval)
+{
+}
+
+CachingClient::~CachingClient()
+{
+}
+
+Client* CachingClient::getClient()
+{
+	return _client;
+}
+
+void CachingClient::setRefreshInterval(long interval)
+{
+	_interval = interval;
+}
+
+long CachingClient::getRefreshInterval()const
+{
+	return _interval;
+}
+
+void CachingClient::watchDevice(const std::string& dev)
+{
+	/* Insert an empty, not loaded, mirror if not already watched. */
+	_devices[dev];
+}
+
+void CachingClient::unwatchDevice(const std::string& dev)
+{
+	_devices.erase(dev);
+}
+
+bool CachingClient::isWatchingDevice(const std::string& dev)const
+{
+	return _devices.find(dev) != _devices.end();
+}
+
+void CachingClient::addListener(VariableListener* listener)
+{
+	if(listener!=NULL)
+	{
+		_listeners.push_back(listener);
+	}
+}
+
+void CachingClient::removeListener(VariableListener* listener)
+{
+	for(std::vector<VariableListener*>::iterator it=_listeners.begin(); it!=_listeners.end(); ++it)
+	{
+		if(*it==listener)
+		{
+			_listeners.erase(it);
+			return;
+		}
+	}
+}
+
+bool CachingClient::isStale(const DeviceCache& cache, time_t now)const
+{
+	return !cache.loaded || now < cache.timestamp || now - cache.timestamp >= _interval;
+}
+
+void CachingClient::update(const std::string& dev, DeviceCache& cache, time_t now)throw(NutException)
+{
+	VariableMap vars = _client->getDeviceVariableValues(dev);
+	bool notify = cache.loaded && !_listeners.empty();
+
+	/* Update the mirror first: listeners may read it back, or throw. */
+	cache.variables.swap(vars);
+	cache.timestamp = now;
+	cache.loaded = true;
+
+	/* Do not notify initial values, only changes against a previous state. */
+	if(!notify)
+	{
+		return;
+	}
+
+	/* vars now holds the previous values. Diff against a copy of the new
+	 * ones, as a listener may refresh or unwatch the device meanwhile. */
+	VariableMap current(cache.variables);
+
+	/* Both maps are sorted by name: walk them in parallel. */
+	VariableMap::const_iterator oldit = vars.begin();
+	VariableMap::const_iterator newit = current.begin();
+	while(oldit!=vars.end() || newit!=current.end())
+	{
+		if(newit==current.end() || (oldit!=vars.end() && oldit->first < newit->first))
+		{
+			for(size_t n=0; n<_listeners.size(); ++n)
+				_listeners[n]->variableRemoved(dev, oldit->first);
+			++oldit;
+		}
+		else if(oldit==vars.end() || newit->first < oldit->first)
+		{
+			for(size_t n=0; n<_listeners.size(); ++n)
+				_listeners[n]->variableChanged(dev, newit->first, newit->second);
+			++newit;
+		}
+		else
+		{
+			if(oldit->second != newit->second)
+			{
+				for(size_t n=0; n<_listeners.size(); ++n)
+					_listeners[n]->variableChanged(dev, newit->first, newit->second);
+			}
+			++oldit;
+			++newit;
+		}
+	}
+}
+
+bool CachingClient::poll()throw(NutException)
+{
+	bool res = false;
+	time_t now = time(NULL);
+
+	for(std::map<std::string, DeviceCache>::iterator it=_devices.begin(); it!=_devices.end(); ++it)
+	{
+		if(isStale(it->second, now))
+		{
+			update(it->first, it->second, now);
+			res = true;
+		}
+	}
+
+	return res;
+}
+
+void CachingClient::refresh()throw(NutException)
+{
+	time_t now = time(NULL);
+
+	for(std::map<std::string, DeviceCache>::iterator it=_devices.begin(); it!=_devices.end(); ++it)
+	{
+		update(it->first, it->second, now);
+	}
+}
+
+void CachingClient::refresh(const std::string& dev)throw(NutException)
+{
+	std::map<std::string, DeviceCache>::iterator it = _devices.find(dev);
+	if(it!=_devices.end())
+	{
+		update(it->first, it->second, time(NULL));
+	}
+}
+
+const CachingClient::DeviceCache* CachingClient::getCache(const std::string& dev)throw(NutException)
+{
+	std::map<std::string, DeviceCache>::iterator it = _devices.find(dev);
+	if(it==_devices.end())
+	{
+		return NULL;
+	}
+
+	time_t now = time(NULL);
+	if(isStale(it->second, now))
+	{
+		update(it->first, it->second, now);
+	}
+	return &it->second;
+}
+
+void CachingClient::authenticate(const std::string& user, const std::string& passwd)throw(NutException)
+{
+	_client->authenticate(user, passwd);
+}
+
+void CachingClient::logout()throw(NutException)
+{
+	_client->logout();
+}
+
+std::set<std::string> CachingClient::getDeviceNames()throw(NutException)
+{
+	return _client->getDeviceNames();
+}
+
+std::string CachingClient::getDeviceDescription(const std::string& name)throw(NutException)
+{
+	return _client->getDeviceDescription(name);
+}
+
+std::set<std::string> CachingClient::getDeviceVariableNames(const std::string& dev)throw(NutException)
+{
+	const DeviceCache* cache = getCache(dev);
+	if(cache==NULL)
+	{
+		return _client->getDeviceVariableNames(dev);
+	}
+
+	std::set<std::string> names;
+	for(VariableMap::const_iterator it=cache->variables.begin(); it!=cache->variables.end(); ++it)
+	{
+		names.insert(names.end(), it->first);
+	}
+	return names;
+}
+
+std::set<std::string> CachingClient::getDeviceRWVariableNames(const std::string& dev)throw(NutException)
+{
+	return _client->getDeviceRWVariableNames(dev);
+}
+
+bool CachingClient::hasDeviceVariable(const std::string& dev, const std::string& name)throw(NutException)
+{
+	const DeviceCache* cache = getCache(dev);
+	if(cache==NULL)
+	{
+		return _client->hasDeviceVariable(dev, name);
+	}
+	return cache->variables.find(name) != cache->variables.end();
+}
+
+std::string CachingClient::getDeviceVariableDescription(const std::string& dev, const std::string& name)throw(NutException)
+{
+	return _client->getDeviceVariableDescription(dev, name);
+}
+
+std::vector<std::string> CachingClient::getDeviceVariableValue(const std::string& dev, const std::string& name)throw(NutException)
+{
+	const DeviceCache* cache = getCache(dev);
+	if(cache==NULL)
+	{
+		return _client->getDeviceVariableValue(dev, name);
+	}
+
+	VariableMap::const_iterator it = cache->variables.find(name);
+	if(it==cache->variables.end())
+	{
+		/* Same error as reported by upsd. */
+		throw NutException("VAR-NOT-SUPPORTED");
+	}
+	return it->second;
+}
+
+std::map<std::string,std::vector<std::string> > CachingClient::getDeviceVariableValues(const std::string& dev)throw(NutException)
+{
+	const DeviceCache* cache = getCache(dev);
+	if(cache==NULL)
+	{
+		return _client->getDeviceVariableValues(dev);
+	}
+	return cache->variables;
+}
+
+void CachingClient::setDeviceVariable(const std::string& dev, const std::string& name, const std::string& value)throw(NutException)
+{
+	/* The mirror is updated when the driver reports the new value. */
+	_client->setDeviceVariable(dev, name, value);
+}
+
+void CachingClient::setDeviceVariable(const std::string& dev, const std::string& name, const std::vector<std::string>& values)throw(NutException)
+{
+	_client->setDeviceVariable(dev, name, values);
+}
+
+std::set<std::string> CachingClient::getDeviceCommandNames(const std::string& dev)throw(NutException)
+{
+	return _client->getDeviceCommandNames(dev);
+}
+
+std::string CachingClient::getDeviceCommandDescription(const std::string& dev, const std::string& name)throw(NutException)
+{
+	return _client->getDeviceCommandDescription(dev, name);
+}
+
+void CachingClient::executeDeviceCommand(const std::string& dev, const std::string& name)throw(NutException)
+{
+	_client->executeDeviceCommand(dev, name);
+}
+
+void CachingClient::deviceLogin(const std::string& dev)throw(NutException)
+{
+	_client->deviceLogin(dev);
+}
+
+void CachingClient::deviceMaster(const std::string& dev)throw(NutException)
+{
+	_client->deviceMaster(dev);
+}
+
+void CachingClient::deviceForcedShutdown(const std::string& dev)throw(NutException)
+{
+	_client->deviceForcedShutdown(dev);
+}
+
+int CachingClient::deviceGetNumLogins(const std::string& dev)throw(NutException)
+{
+	return _client->deviceGetNumLogins(dev);
+}
+
 /*
  *
  * Device implementation
@@ -28,6 +28,7 @@
 #include <map>
 #include <set>
 #include <exception>
+#include <ctime>
 
 namespace nut
 {
@@ -402,6 +403,162 @@ private:
 	internal::Socket* _socket;
 };
 
+/**
+ * Listener notified by a CachingClient when cached variable values change.
+ */
+class VariableListener
+{
+public:
+	virtual ~VariableListener() {}
+
+	/**
+	 * Called when a variable appears or when its value changes.
+	 * \param dev Device name.
+	 * \param name Variable name.
+	 * \param value New variable values.
+	 */
+	virtual void variableChanged(const std::string& dev, const std::string& name, const std::vector<std::string>& value) = 0;
+	/**
+	 * Called when a variable is no more provided by a device.
+	 * \param dev Device name.
+	 * \param name Variable name.
+	 */
+	virtual void variableRemoved(const std::string& /*dev*/, const std::string& /*name*/) {}
+};
+
+/**
+ * Caching NUTD client.
+ * It keeps a local mirror of the variables of watched devices, fetched
+ * from another client with one LIST VAR per device, and serves variable
+ * reads from it without network I/O.
+ * The mirror is refreshed when it is older than the refresh interval, either
+ * on access or when the application calls poll() from its main loop.
+ * Variables of non-watched devices and all other requests are forwarded
+ * to the underlying client.
+ * \note The underlying client is not owned and must outlive the cache.
+ */
+class CachingClient : public Client
+{
+public:
+	/**
+	 * Construct a caching client on top of another client.
+	 * \param client Client used to query the server.
+	 * \param interval Refresh interval in seconds.
+	 */
+	CachingClient(Client* client, long interval = 5);
+	~CachingClient();
+
+	/**
+	 * Retrieve the underlying client.
+	 */
+	Client* getClient();
+
+	/**
+	 * Set the refresh interval in seconds.
+	 * \param interval Refresh interval, 0 to refresh on each access.
+	 */
+	void setRefreshInterval(long interval);
+	/**
+	 * Retrieve the refresh interval in seconds.
+	 */
+	long getRefreshInterval()const;
+
+	/**
+	 * Add a device to the set of locally mirrored devices.
+	 * Its variables are fetched on the next access or poll.
+	 * \param dev Device name.
+	 */
+	void watchDevice(const std::string& dev);
+	/**
+	 * Remove a device from the set of locally mirrored devices.
+	 * \param dev Device name.
+	 */
+	void unwatchDevice(const std::string& dev);
+	/**
+	 * Test if a device is locally mirrored.
+	 * \param dev Device name.
+	 */
+	bool isWatchingDevice(const std::string& dev)const;
+
+	/**
+	 * Register a listener to be notified of variable changes.
+	 * Listeners are not owned by the client.
+	 */
+	void addListener(VariableListener* listener);
+	/**
+	 * Unregister a listener.
+	 */
+	void removeListener(VariableListener* listener);
+
+	/**
+	 * Refresh the mirror of all watched devices whose data are older than
+	 * the refresh interval, notifying listeners of changed variables.
+	 * \return true if at least one device has been refreshed.
+	 */
+	bool poll()throw(NutException);
+	/**
+	 * Unconditionally refresh the mirror of all watched devices.
+	 */
+	void refresh()throw(NutException);
+	/**
+	 * Unconditionally refresh the mirror of a watched device.
+	 * \param dev Device name.
+	 */
+	void refresh(const std::string& dev)throw(NutException);
+
+	virtual void authenticate(const std::string& user, const std::string& passwd)throw(NutException);
+	virtual void logout()throw(NutException);
+
+	virtual std::set<std::string> getDeviceNames()throw(NutException);
+	virtual std::string getDeviceDescription(const std::string& name)throw(NutException);
+
+	virtual std::set<std::string> getDeviceVariableNames(const std::string& dev)throw(NutException);
+	virtual std::set<std::string> getDeviceRWVariableNames(const std::string& dev)throw(NutException);
+	virtual bool hasDeviceVariable(const std::string& dev, const std::string& name)throw(NutException);
+	virtual std::string getDeviceVariableDescription(const std::string& dev, const std::string& name)throw(NutException);
+	virtual std::vector<std::string> getDeviceVariableValue(const std::string& dev, const std::string& name)throw(NutException);
+	virtual std::map<std::string,std::vector<std::string> > getDeviceVariableValues(const std::string& dev)throw(NutException);
+	virtual void setDeviceVariable(const std::string& dev, const std::string& name, const std::string& value)throw(NutException);
+	virtual void setDeviceVariable(const std::string& dev, const std::string& name, const std::vector<std::string>& values)throw(NutException);
+
+	virtual std::set<std::string> getDeviceCommandNames(const std::string& dev)throw(NutException);
+	virtual std::string getDeviceCommandDescription(const std::string& dev, const std::string& name)throw(NutException);
+	virtual void executeDeviceCommand(const std::string& dev, const std::string& name)throw(NutException);
+
+	virtual void deviceLogin(const std::string& dev)throw(NutException);
+	virtual void deviceMaster(const std::string& dev)throw(NutException);
+	virtual void deviceForcedShutdown(const std::string& dev)throw(NutException);
+	virtual int deviceGetNumLogins(const std::string& dev)throw(NutException);
+
+protected:
+	typedef std::map<std::string,std::vector<std::string> > VariableMap;
+
+	/**
+	 * Local mirror of the variables of a device.
+	 */
+	struct DeviceCache
+	{
+		DeviceCache():loaded(false),timestamp(0){}
+		bool loaded;
+		time_t timestamp;
+		VariableMap variables;
+	};
+
+	/**
+	 * Retrieve the up-to-date mirror of a watched device, refreshing it if needed.
+	 * \return The mirror or NULL if the device is not watched.
+	 */
+	const DeviceCache* getCache(const std::string& dev)throw(NutException);
+	bool isStale(const DeviceCache& cache, time_t now)const;
+	void update(const std::string& dev, DeviceCache& cache, time_t now)throw(NutException);
+
+private:
+	Client* _client;
+	long _interval;
+	std::map<std::string, DeviceCache> _devices;
+	std::vector<VariableListener*> _listeners;
+};
+
 
 /**
  * Device attached to a client.
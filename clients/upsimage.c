@@ -53,6 +53,10 @@ static	int	port;
 static	char	*upsname, *hostname;
 static	UPSCONN_t	ups;
 
+	/* ETag of the image being drawn, and where to keep it (if CACHE) */
+static	char	etag[32] = "";
+static	char	*imgfn = NULL;
+
 #define RED(x)		((x >> 16) & 0xff)
 #define GREEN(x)	((x >> 8)  & 0xff)
 #define BLUE(x)		(x & 0xff)
@@ -110,20 +114,94 @@ static int get_imgarg(const char *name)
 	return -1;
 }
 
-/* write the HTML header then have gd dump the image */
-static void drawimage(gdImagePtr im)
+/* write the HTML header then the PNG data */
+static void sendimage(const void *png, size_t size)
 {
 	printf("Pragma: no-cache\n");
+
+	/* let the browser revalidate with If-None-Match */
+	if (etag[0]) {
+		printf("Cache-Control: no-cache\n");
+		printf("ETag: \"%s\"\n", etag);
+	}
+
 	printf("Content-type: image/png\n\n");
 
-	gdImagePng(im, stdout);
+	fwrite(png, 1, size, stdout);
+}
+
+/* have gd dump the image, keeping a copy for the next requests */
+static void drawimage(gdImagePtr im)
+{
+	void	*png;
+	int	size;
+	char	tmpfn[LARGEBUF];
+	FILE	*f;
+
+	png = gdImagePngPtr(im, &size);
 	gdImageDestroy(im);
 
 	upscli_disconnect(&ups);
 
+	if (!png)
+		exit(EXIT_FAILURE);
+
+	sendimage(png, size);
+
+	if (imgfn) {
+		/* the images of values that went by would pile up otherwise */
+		cgicache_prune("upsimage-");
+
+		snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", imgfn, (long)getpid());
+
+		f = fopen(tmpfn, "wb");
+
+		if (f) {
+			fwrite(png, 1, size, f);
+
+			if ((fclose(f) != 0) || (rename(tmpfn, imgfn) != 0))
+				unlink(tmpfn);
+		}
+	}
+
+	gdFree(png);
+
 	exit(EXIT_SUCCESS);
 }
 
+/* send a previously rendered image */
+static int sendcached(const char *fn)
+{
+	FILE	*f;
+	char	*png;
+	struct stat	fs;
+
+	f = fopen(fn, "rb");
+
+	if (!f)
+		return 0;
+
+	if ((fstat(fileno(f), &fs) != 0) || (fs.st_size <= 0)) {
+		fclose(f);
+		return 0;
+	}
+
+	png = xmalloc(fs.st_size);
+
+	if (fread(png, 1, fs.st_size, f) != (size_t)fs.st_size) {
+		free(png);
+		fclose(f);
+		return 0;
+	}
+
+	fclose(f);
+
+	sendimage(png, fs.st_size);
+	free(png);
+
+	return 1;
+}
+
 /* helper function to allocate color in the image */
 static int color_alloc(gdImagePtr im, int rgb)
 {
@@ -493,12 +571,74 @@ static void draw_humidity(double var, int min, int nom, int max,
 	drawbar(0, 100, 2, 10, 20, 0, min, max, 100, -1, -1, var, format);
 }
 
+/* the image only depends on the displayed value, the min/nom/max values
+   and the imgarg parameters: derive the ETag from them, then don't draw
+   anything if the browser or the cache already has this image */
+static void check_image(const imgvar_t *iv, double *var, int min, int nom, int max)
+{
+	char	key[LARGEBUF], text[SMALLBUF], *inm;
+	unsigned long	h1 = 2166136261UL, h2 = 5381;
+	const	char	*ptr, *cachedir;
+	int	i;
+
+	/* quantize the value to what will be displayed */
+	snprintf(text, sizeof(text), iv->format, *var);
+	*var = strtod(text, NULL);
+
+	snprintf(key, sizeof(key), "%s %s %d %d %d", iv->name, text, min, nom, max);
+
+	for (i = 0; imgarg[i].name != NULL; i++)
+		snprintfcat(key, sizeof(key), " %d", imgarg[i].val);
+
+	/* FNV-1a and djb2 hashes */
+	for (ptr = key; *ptr; ptr++) {
+		h1 = ((h1 ^ (unsigned char)*ptr) * 16777619UL) & 0xffffffffUL;
+		h2 = ((h2 * 33) + (unsigned char)*ptr) & 0xffffffffUL;
+	}
+
+	snprintf(etag, sizeof(etag), "%08lx%08lx", h1, h2);
+
+	inm = getenv("HTTP_IF_NONE_MATCH");
+
+	if ((inm) && ((!strcmp(inm, "*")) || (strstr(inm, etag)))) {
+		printf("Status: 304 Not Modified\n");
+		printf("ETag: \"%s\"\n\n", etag);
+
+		upscli_disconnect(&ups);
+		exit(EXIT_SUCCESS);
+	}
+
+	cachedir = cgicache_dir();
+
+	if (!cachedir)
+		return;
+
+	snprintf(key, sizeof(key), "%s/upsimage-%s.png", cachedir, etag);
+	imgfn = xstrdup(key);
+
+	if (sendcached(imgfn)) {
+		upscli_disconnect(&ups);
+		exit(EXIT_SUCCESS);
+	}
+}
+
 static int get_var(const char *var, char *buf, size_t buflen)
 {
 	int	ret;
 	unsigned int	numq, numa;
 	const	char	*query[4];
 	char	**answer;
+	const	char	*val;
+
+	if (cgicache_fresh(monhost)) {
+		val = cgicache_get(monhost, var);
+
+		if (!val)
+			return 0;
+
+		snprintf(buf, buflen, "%s", val);
+		return 1;
+	}
 
 	query[0] = "VAR";
 	query[1] = upsname;
@@ -540,10 +680,15 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
-	if (upscli_connect(&ups, hostname, port, 0) < 0) {
-		noimage("Can't connect to server:\n%s\n",
-			upscli_strerror(&ups));
-		exit(EXIT_FAILURE);
+	/* a recent snapshot saves the connection to upsd */
+	if (!cgicache_fresh(monhost)) {
+		if (upscli_connect(&ups, hostname, port, 0) < 0) {
+			noimage("Can't connect to server:\n%s\n",
+				upscli_strerror(&ups));
+			exit(EXIT_FAILURE);
+		}
+
+		cgicache_update(monhost, &ups, upsname);
 	}
 
 	for (i = 0; imgvar[i].name; i++)
@@ -611,6 +756,8 @@ int main(int argc, char **argv)
 				max = -1;
 			}
 
+			check_image(&imgvar[i], &var, min, nom, max);
+
 			imgvar[i].drawfunc(var, min, nom, max,
 				imgvar[i].deviation, imgvar[i].format);
 			exit(EXIT_SUCCESS);
@@ -29,6 +29,11 @@
  * That means the main loop just has to run the linked list and call
  * anything it finds in there.  Everything happens from there, and we
  * don't have to pointlessly reparse the string every time around.
+ *
+ * The variables used by the format are also collected at that point.
+ * They are fetched with a single LIST VAR before each line, so a line
+ * costs one round trip to upsd, and all of its values come from the
+ * same update of the driver.
  */
 
 #include "common.h"
@@ -48,6 +53,7 @@
 	static	char	logbuffer[LARGEBUF], *logformat;
 
 	static	flist_t	*fhead = NULL;
+	static	vlist_t	*vhead = NULL;
 
 #define DEFAULT_LOGFORMAT "%TIME @Y@m@d @H@M@S% %VAR battery.charge% " \
 		"%VAR input.voltage% %VAR ups.load% [%VAR ups.status%] " \
@@ -178,26 +184,93 @@ static void do_time(const char *arg)
 	free(format);
 }
 
-static void getvar(const char *var)
+/* remember a variable used by the format */
+static void add_var(const char *var)
+{
+	vlist_t	*tmp, *last = NULL;
+
+	for (tmp = vhead; tmp != NULL; tmp = tmp->next) {
+		if (!strcasecmp(tmp->var, var))
+			return;
+
+		last = tmp;
+	}
+
+	tmp = xcalloc(1, sizeof(vlist_t));
+	tmp->var = xstrdup(var);
+
+	if (last)
+		last->next = tmp;
+	else
+		vhead = tmp;
+}
+
+/* get the values of all the variables used by the format at once */
+static void fetch_vars(void)
 {
 	int	ret;
 	unsigned int	numq, numa;
-	const	char	*query[4];
+	const	char	*query[2];
 	char	**answer;
+	vlist_t	*tmp;
+
+	for (tmp = vhead; tmp != NULL; tmp = tmp->next) {
+		free(tmp->val);
+		tmp->val = NULL;
+	}
+
+	if ((!vhead) || (!upsname))
+		return;
 
 	query[0] = "VAR";
 	query[1] = upsname;
-	query[2] = var;
-	numq = 3;
+	numq = 2;
+
+	ret = upscli_list_start(&ups, numq, query);
+
+	if (ret < 0)
+		return;
 
-	ret = upscli_get(&ups, numq, query, &numa, &answer);
+	while ((ret = upscli_list_next(&ups, numq, query, &numa, &answer)) == 1) {
 
-	if ((ret < 0) || (numa < numq)) {
+		/* VAR <upsname> <varname> <val> */
+		if (numa < 4)
+			continue;
+
+		for (tmp = vhead; tmp != NULL; tmp = tmp->next) {
+			if (!strcasecmp(tmp->var, answer[2])) {
+				free(tmp->val);
+				tmp->val = xstrdup(answer[3]);
+				break;
+			}
+		}
+	}
+
+	if (ret == 0)
+		return;
+
+	/* the list was cut short: log a line of NA rather than a mix */
+	for (tmp = vhead; tmp != NULL; tmp = tmp->next) {
+		free(tmp->val);
+		tmp->val = NULL;
+	}
+}
+
+static void getvar(const char *var)
+{
+	vlist_t	*tmp;
+
+	for (tmp = vhead; tmp != NULL; tmp = tmp->next) {
+		if (!strcasecmp(tmp->var, var))
+			break;
+	}
+
+	if ((!tmp) || (!tmp->val)) {
 		snprintfcat(logbuffer, sizeof(logbuffer), "NA");
 		return;
 	}
 
-	snprintfcat(logbuffer, sizeof(logbuffer), "%s", answer[3]);
+	snprintfcat(logbuffer, sizeof(logbuffer), "%s", tmp->val);
 }
 
 static void do_var(const char *arg)
@@ -325,6 +398,12 @@ static void compile_format(void)
 
 				add_call(logcmds[j].func, arg);
 				found = 1;
+
+				/* same checks as do_var() */
+				if ((logcmds[j].func == do_var) && arg &&
+					strchr(arg, '.'))
+					add_var(arg);
+
 				break;
 			}
 		}
@@ -347,6 +426,8 @@ static void run_flist(void)
 
 	tmp = fhead;
 
+	fetch_vars();
+
 	memset(logbuffer, 0, sizeof(logbuffer));
 
 	while (tmp) {
@@ -13,6 +13,13 @@ typedef struct flist_s {
 	struct flist_s	*next;
 } flist_t;
 
+/* variables used by the format, and their values for the current line */
+typedef struct vlist_s {
+	char	*var;
+	char	*val;
+	struct vlist_s	*next;
+} vlist_t;
+
 static void do_host(const char *arg);
 static void do_upshost(const char *arg);
 static void do_pid(const char *arg);
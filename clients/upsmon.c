@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 
 #include "upsclient.h"
 #include "upsmon.h"
@@ -34,7 +35,7 @@
 #include <stdarg.h>
 #endif
 
-static	char	*shutdowncmd = NULL, *notifycmd = NULL;
+static	char	*shutdowncmd = NULL, *notifycmd = NULL, *notifysock = NULL;
 static	char	*powerdownflag = NULL, *configfile = NULL;
 
 static	int	minsupplies = 1, sleepval = 5, deadtime = 15;
@@ -113,6 +114,51 @@ static void wall(const char *text)
 	pclose(wf);
 } 
 
+/* hand the event to a upssched daemon, returns 1 if it was sent */
+static int notify_sock(const char *ntype, const char *upsname)
+{
+	int	fd, ret;
+	char	buf[SMALLBUF], enc[SMALLBUF];
+	struct	sockaddr_un	sa;
+
+	memset(&sa, '\0', sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", notifysock);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		upslog_with_errno(LOG_ERR, "Can't create socket for NOTIFYSOCK");
+		return 0;
+	}
+
+	/* don't get stuck if the daemon doesn't keep up */
+	ret = fcntl(fd, F_GETFL, 0);
+
+	if ((ret < 0) || (fcntl(fd, F_SETFL, ret | O_NONBLOCK) < 0) ||
+		(connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)) {
+		upsdebug_with_errno(2, "Can't connect to %s", notifysock);
+		close(fd);
+		return 0;
+	}
+
+	snprintf(buf, sizeof(buf), "EVENT \"%s\"",
+		pconf_encode(upsname ? upsname : "", enc, sizeof(enc)));
+	snprintfcat(buf, sizeof(buf), " \"%s\"\n",
+		pconf_encode(ntype, enc, sizeof(enc)));
+
+	/* the reply isn't needed, the daemon carries on without us */
+	ret = write(fd, buf, strlen(buf));
+	close(fd);
+
+	if (ret != (int) strlen(buf)) {
+		upsdebug_with_errno(2, "Can't send the event to %s", notifysock);
+		return 0;
+	}
+
+	return 1;
+}
+
 static void notify(const char *notice, int flags, const char *ntype, 
 			const char *upsname)
 {
@@ -125,6 +171,16 @@ static void notify(const char *notice, int flags, const char *ntype,
 	if (flag_isset(flags, NOTIFY_SYSLOG))
 		upslogx(LOG_NOTICE, "%s", notice);
 
+	/* send it to upssched directly, or fall back to NOTIFYCMD */
+	if (flag_isset(flags, NOTIFY_EXEC) && (notifysock != NULL)) {
+		if (notify_sock(ntype, upsname))
+			clearflag(&flags, NOTIFY_EXEC);
+	}
+
+	/* nothing left to do in the background */
+	if (!flag_isset(flags, NOTIFY_WALL) && !flag_isset(flags, NOTIFY_EXEC))
+		return;
+
 	/* fork here so upsmon doesn't get wedged if the notifier is slow */
 	ret = fork();
 
@@ -1090,6 +1146,13 @@ static int parse_conf_arg(int numargs, char **arg)
 		return 1;
 	}
 
+	/* NOTIFYSOCK <path> */
+	if (!strcmp(arg[0], "NOTIFYSOCK")) {
+		free(notifysock);
+		notifysock = xstrdup(arg[1]);
+		return 1;
+	}
+
 	/* POLLFREQ <num> */
 	if (!strcmp(arg[0], "POLLFREQ")) {
 		pollfreq = atoi(arg[1]);
@@ -1312,6 +1375,7 @@ static void upsmon_cleanup(void)
 	free(run_as_user);
 	free(shutdowncmd);
 	free(notifycmd);
+	free(notifysock);
 	free(powerdownflag);
 
 	for (i = 0; notifylist[i].name != NULL; i++) {
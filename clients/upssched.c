@@ -37,6 +37,15 @@
  *
  * the daemon will shut down automatically when no more timers are active
  *
+ * with -d, the daemon is started once and stays up even without timers,
+ * with the AT rules parsed only once.  upsmon can then send the events
+ * straight to its socket (EVENT <upsname> <notifytype>), without starting
+ * a new upssched for each one
+ *
+ * the timers are kept in a binary heap ordered by expiry time, so the
+ * daemon sleeps until the next one is due, and in a hash by name for
+ * cancelling
+ *
  */
 
 #include "common.h"
@@ -52,36 +61,71 @@
 
 typedef struct ttype_s {
 	char	*name;
-	time_t	etime;
-	struct ttype_s	*next;
+	unsigned long long	etime;	/* monotonic, in microseconds */
+	unsigned long	seq;		/* start order, for equal etimes */
+	size_t	pos;			/* index in theap */
+	struct ttype_s	*next;		/* same tname bucket, oldest first */
 } ttype_t;
 
-	ttype_t	*thead = NULL;
+#define TIMER_HASH_SIZE		256	/* power of 2 */
+
+	static	ttype_t	**theap = NULL, *tname[TIMER_HASH_SIZE];
+	static	size_t	tcount = 0, theap_size = 0;
+	static	unsigned long	tseq = 0;
 	static	conn_t	*connhead = NULL;
 	char	*cmdscript = NULL, *pipefn = NULL, *lockfn = NULL;
 	int	verbose = 0;		/* use for debugging */
 
+	static	at_t	*athead = NULL;
+	static	int	is_daemon = 0, persistent = 0, reload_flag = 0;
+	static	int	reloading = 0, conf_failed = 0;
+	static	int	wakeup_pipe[2] = { -1, -1 };
 
-	/* ups name and notify type (string) as received from upsmon */
-	const	char	*upsname, *notify_type;
+static void run_rules(const char *un, const char *ntype);
+static void reload_conf(void);
 
 #define PARENT_STARTED		-2
 #define PARENT_UNNECESSARY	-3
 #define MAX_TRIES 		30
-#define EMPTY_WAIT		15	/* min passes with no timers to exit */
+#define EMPTY_WAIT		15	/* seconds with no timers to exit */
 #define US_LISTEN_BACKLOG	16
 #define US_SOCK_BUF_LEN		256
 #define US_MAX_READ		128
 
 /* --- server functions --- */
 
-static void exec_cmd(const char *cmd)
+/* upsname and ntype are exported to the command when given, otherwise
+ * it inherits the values upsmon handed to us */
+static void exec_cmd(const char *cmd, const char *upsname, const char *ntype)
 {
 	int	err;
+	pid_t	pid;
 	char	buf[LARGEBUF];
 
 	snprintf(buf, sizeof(buf), "%s %s", cmdscript, cmd);
 
+	/* the daemon must keep serving its clients and timers while the
+	   command runs: leave it to a child, reaped by the SIGCHLD handling */
+	if (is_daemon) {
+		pid = fork();
+
+		if (pid < 0) {
+			upslog_with_errno(LOG_ERR, "Can't fork to execute %s", buf);
+			return;
+		}
+
+		if (pid != 0)	/* parent */
+			return;
+
+		signal(SIGCHLD, SIG_DFL);
+	}
+
+	if (upsname)
+		setenv("UPSNAME", upsname, 1);
+
+	if (ntype)
+		setenv("NOTIFYTYPE", ntype, 1);
+
 	err = system(buf);
 	if (WIFEXITED(err)) {
 		if (WEXITSTATUS(err)) {
@@ -95,51 +139,148 @@ static void exec_cmd(const char *cmd)
 		}
 	}
 
-	return;
+	/* the child must not run the daemon's exit path */
+	if (is_daemon)
+		_exit(EXIT_SUCCESS);
 }
 
-static void removetimer(ttype_t *tfind)
+static size_t hash_name(const char *name)
 {
-	ttype_t	*tmp, *last;
+	size_t	hash = 5381;
 
-	last = NULL;
-	tmp = thead;
+	while (*name) {
+		hash = (hash * 33) + (unsigned char)*name++;
+	}
 
-	while (tmp) {
-		if (tmp == tfind) {	/* found it */
-			if (last == NULL)	/* deleting first */
-				thead = tmp->next;
-			else
-				last->next = tmp->next;
+	return hash & (TIMER_HASH_SIZE - 1);
+}
 
-			free(tmp->name);
-			free(tmp);
-			return;
-		}
+/* does a expire before b? */
+static int timer_before(const ttype_t *a, const ttype_t *b)
+{
+	if (a->etime != b->etime)
+		return a->etime < b->etime;
 
-		last = tmp;
-		tmp = tmp->next;
+	return a->seq < b->seq;
+}
+
+static void heap_set(size_t pos, ttype_t *tmp)
+{
+	theap[pos] = tmp;
+	tmp->pos = pos;
+}
+
+static void heap_up(size_t pos)
+{
+	ttype_t	*tmp = theap[pos];
+
+	while (pos > 0) {
+		size_t	parent = (pos - 1) / 2;
+
+		if (!timer_before(tmp, theap[parent]))
+			break;
+
+		heap_set(pos, theap[parent]);
+		pos = parent;
+	}
+
+	heap_set(pos, tmp);
+}
+
+static void heap_down(size_t pos)
+{
+	ttype_t	*tmp = theap[pos];
+
+	for (;;) {
+		size_t	child = 2 * pos + 1;
+
+		if (child >= tcount)
+			break;
+
+		if ((child + 1 < tcount) && timer_before(theap[child + 1], theap[child]))
+			child++;
+
+		if (!timer_before(theap[child], tmp))
+			break;
+
+		heap_set(pos, theap[child]);
+		pos = child;
+	}
+
+	heap_set(pos, tmp);
+}
+
+static void removetimer(ttype_t *tfind)
+{
+	ttype_t	**tptr, *last;
+
+	for (tptr = &tname[hash_name(tfind->name)]; *tptr; tptr = &(*tptr)->next) {
+		if (*tptr == tfind)
+			break;
 	}
 
 	/* this one should never happen */
+	if ((*tptr == NULL) || (tfind->pos >= tcount) || (theap[tfind->pos] != tfind)) {
+		upslogx(LOG_ERR, "removetimer: failed to locate target at %p", (void *)tfind);
+		return;
+	}
+
+	*tptr = tfind->next;
+
+	/* fill the hole with the last one, and move it where it belongs */
+	last = theap[--tcount];
+
+	if (last != tfind) {
+		heap_set(tfind->pos, last);
+		heap_up(last->pos);
+		heap_down(last->pos);
+	}
 
-	upslogx(LOG_ERR, "removetimer: failed to locate target at %p", (void *)tfind);
+	free(tfind->name);
+	free(tfind);
 }
 
-static void checktimers(void)
+/* run the expired timers, and return how long to sleep until the next one,
+ * or NULL to wait for the next command */
+static struct timeval *checktimers(struct timeval *tv)
 {
-	ttype_t	*tmp, *tmpnext;
-	time_t	now;
-	static	int	emptyctr = 0;
+	ttype_t	*tmp;
+	unsigned long long	now, wait;
+	static	unsigned long long	empty_since = 0;
+
+	now = monotime_usec();
+
+	while ((tcount > 0) && (theap[0]->etime <= now)) {
+		tmp = theap[0];
+
+		if (verbose)
+			upslogx(LOG_INFO, "Event: %s ", tmp->name);
+
+		exec_cmd(tmp->name, NULL, NULL);
+
+		/* delete from queue */
+		removetimer(tmp);
+
+		/* the command may have taken a while */
+		now = monotime_usec();
+	}
 
 	/* if the queue is empty we might be ready to exit */
-	if (!thead) {
+	if (tcount == 0) {
+
+		if (persistent)
+			return NULL;
 
-		emptyctr++;
+		if (empty_since == 0)
+			empty_since = now;
 
 		/* wait a little while in case someone wants us again */
-		if (emptyctr < EMPTY_WAIT)
-			return;
+		if (now - empty_since < EMPTY_WAIT * 1000000ULL) {
+			wait = empty_since + EMPTY_WAIT * 1000000ULL - now;
+			tv->tv_sec = wait / 1000000;
+			tv->tv_usec = wait % 1000000;
+			return tv;
+		}
 
 		if (verbose)
 			upslogx(LOG_INFO, "Timer queue empty, exiting");
@@ -153,37 +294,19 @@ static void checktimers(void)
 		exit(EXIT_SUCCESS);
 	}
 
-	emptyctr = 0;
-
-	/* flip through LL, look for activity */
-	tmp = thead;
+	empty_since = 0;
 
-	time(&now);
-	while (tmp) {
-		tmpnext = tmp->next;
-
-		if (now >= tmp->etime) {
-			if (verbose)
-				upslogx(LOG_INFO, "Event: %s ", tmp->name);
-
-			exec_cmd(tmp->name);
-
-			/* delete from queue */
-			removetimer(tmp);
-		}
+	wait = theap[0]->etime - now;
+	tv->tv_sec = wait / 1000000;
+	tv->tv_usec = wait % 1000000;
 
-		tmp = tmpnext;
-	}
+	return tv;
 }
 
 static void start_timer(const char *name, const char *ofsstr)
 {
-	time_t	now;
 	int	ofs;
-	ttype_t	*tmp, *last;
-
-	/* get the time */
-	time(&now);
+	ttype_t	*tmp, **tptr;
 
 	/* add an event for <now> + <time> */
 	ofs = strtol(ofsstr, (char **) NULL, 10);
@@ -196,30 +319,33 @@ static void start_timer(const char *name, const char *ofsstr)
 	if (verbose)
 		upslogx(LOG_INFO, "New timer: %s (%d seconds)", name, ofs);
 
-	/* now add to the queue */
-	tmp = last = thead;
-
-	while (tmp) {
-		last = tmp;
-		tmp = tmp->next;
-	}
-
 	tmp = xmalloc(sizeof(ttype_t));
 	tmp->name = xstrdup(name);
-	tmp->etime = now + ofs;
+	tmp->etime = monotime_usec() + ofs * 1000000ULL;
+	tmp->seq = tseq++;
 	tmp->next = NULL;
 
-	if (last)
-		last->next = tmp;
-	else
-		thead = tmp;
+	/* same names are cancelled in the order they were started */
+	for (tptr = &tname[hash_name(name)]; *tptr; tptr = &(*tptr)->next)
+		;
+
+	*tptr = tmp;
+
+	/* now add to the queue */
+	if (tcount == theap_size) {
+		theap_size = theap_size ? theap_size * 2 : 16;
+		theap = xrealloc(theap, theap_size * sizeof(*theap));
+	}
+
+	heap_set(tcount++, tmp);
+	heap_up(tmp->pos);
 }
 
 static void cancel_timer(const char *name, const char *cname)
 {
 	ttype_t	*tmp;
 
-	for (tmp = thead; tmp != NULL; tmp = tmp->next) {
+	for (tmp = tname[hash_name(name)]; tmp != NULL; tmp = tmp->next) {
 		if (!strcmp(tmp->name, name)) {		/* match */
 			if (verbose)
 				upslogx(LOG_INFO, "Cancelling timer: %s", name);
@@ -233,7 +359,7 @@ static void cancel_timer(const char *name, const char *cname)
 		if (verbose)
 			upslogx(LOG_INFO, "Cancel %s, event: %s", name, cname);
 
-		exec_cmd(cname);
+		exec_cmd(cname, NULL, NULL);
 	}
 }
 
@@ -429,6 +555,13 @@ static int sock_arg(conn_t *conn)
 	if (conn->ctx.numargs < 3)
 		return 0;
 
+	/* EVENT <upsname> <notifytype> */
+	if (!strcmp(conn->ctx.arglist[0], "EVENT")) {
+		run_rules(conn->ctx.arglist[1], conn->ctx.arglist[2]);
+		send_to_one(conn, "OK\n");
+		return 1;
+	}
+
 	/* START <name> <length> */
 	if (!strcmp(conn->ctx.arglist[0], "START")) {
 		start_timer(conn->ctx.arglist[1], conn->ctx.arglist[2]);
@@ -493,10 +626,31 @@ static int sock_read(conn_t *conn)
 	return 0;	/* fell out without parsing anything */
 }
 
+/* the signals are handled in the main loop: wake up its select(), which
+   a flag alone can't do if the signal arrives just before the call */
+static void wakeup(int sig)
+{
+	int	err = errno;
+
+	if (write(wakeup_pipe[1], "", 1) < 0) {
+		/* the pipe is full: a wakeup is already pending */
+	}
+
+	errno = err;
+}
+
+static void set_reload_flag(int sig)
+{
+	reload_flag = sig;
+	wakeup(sig);
+}
+
 static void start_daemon(int lockfd)
 {
-	int	maxfd, pid, pipefd, ret;
-	struct	timeval	tv;
+	int	i, maxfd, pid, pipefd, ret;
+	char	buf[SMALLBUF];
+	struct	timeval	tv, *tvp;
+	struct	sigaction	sa;
 	fd_set	rfds;
 	conn_t	*tmp, *tmpnext;
 
@@ -531,6 +685,29 @@ static void start_daemon(int lockfd)
 
 	pipefd = open_sock();
 
+	is_daemon = 1;
+
+	if (pipe(wakeup_pipe) < 0)
+		fatal_with_errno(EXIT_FAILURE, "wakeup pipe");
+
+	for (i = 0; i < 2; i++) {
+		fcntl(wakeup_pipe[i], F_SETFL, fcntl(wakeup_pipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(wakeup_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	/* clients may leave before reading the OK */
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	sa.sa_handler = set_reload_flag;
+	sigaction(SIGHUP, &sa, NULL);
+
+	/* the commands run in children, reaped in the main loop */
+	sa.sa_handler = wakeup;
+	sigaction(SIGCHLD, &sa, NULL);
+
 	if (verbose)
 		upslogx(LOG_INFO, "Timer daemon started");
 
@@ -538,20 +715,31 @@ static void start_daemon(int lockfd)
 	us_serialize(SERIALIZE_SET);
 
 	/* drop the lock now that the background is running */
-	unlink(lockfn);
-	close(lockfd);
+	if (lockfd >= 0) {
+		unlink(lockfn);
+		close(lockfd);
+	}
 
 	/* now watch for activity */
 
 	for (;;) {
-		/* wait at most 1s so we can check our timers regularly */
-		tv.tv_sec = 1;
-		tv.tv_usec = 0;
+		if (reload_flag) {
+			reload_conf();
+			reload_flag = 0;
+		}
+
+		/* collect the commands that have finished */
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			;
+
+		/* sleep until the next timer is due */
+		tvp = checktimers(&tv);
 
 		FD_ZERO(&rfds);
 		FD_SET(pipefd, &rfds);
+		FD_SET(wakeup_pipe[0], &rfds);
 
-		maxfd = pipefd;
+		maxfd = (pipefd > wakeup_pipe[0]) ? pipefd : wakeup_pipe[0];
 
 		for (tmp = connhead; tmp != NULL; tmp = tmp->next) {
 			FD_SET(tmp->fd, &rfds);
@@ -560,10 +748,16 @@ static void start_daemon(int lockfd)
 				maxfd = tmp->fd;
 		}
 
-		ret = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+		ret = select(maxfd + 1, &rfds, NULL, NULL, tvp);
 
 		if (ret > 0) {
 
+			/* the signals are handled at the top of the loop */
+			if (FD_ISSET(wakeup_pipe[0], &rfds)) {
+				while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0)
+					;
+			}
+
 			if (FD_ISSET(pipefd, &rfds))
 				conn_add(pipefd);
 
@@ -582,8 +776,6 @@ static void start_daemon(int lockfd)
 				tmp = tmpnext;
 			}
 		}
-
-		checktimers();
 	}
 }
 
@@ -752,61 +944,134 @@ static void sendcmd(const char *cmd, const char *arg1, const char *arg2)
 	fatalx(EXIT_FAILURE, "Unable to connect to daemon and unable to start daemon");
 }
 
+/* fatal at startup, but a failed reload must not kill the daemon */
+static void conf_fatal(const char *errmsg)
+{
+	if (reloading) {
+		upslogx(LOG_ERR, "%s", errmsg);
+		conf_failed = 1;
+		return;
+	}
+
+	/* complain both ways in case we don't have a tty */
+	printf("%s\n", errmsg);
+	fatalx(EXIT_FAILURE, "%s", errmsg);
+}
+
 static void parse_at(const char *ntype, const char *un, const char *cmd,
 		const char *ca1, const char *ca2)
 {
-	/* complain both ways in case we don't have a tty */
+	at_t	*at, **atptr;
+	int	action;
 
 	if (!cmdscript) {
-		printf("CMDSCRIPT must be set before any ATs in the config file!\n");
-		fatalx(EXIT_FAILURE, "CMDSCRIPT must be set before any ATs in the config file!");
+		conf_fatal("CMDSCRIPT must be set before any ATs in the config file!");
+		return;
 	}
 
 	if (!pipefn) {
-		printf("PIPEFN must be set before any ATs in the config file!\n");
-		fatalx(EXIT_FAILURE, "PIPEFN must be set before any ATs in the config file!");
+		conf_fatal("PIPEFN must be set before any ATs in the config file!");
+		return;
 	}
 
 	if (!lockfn) {
-		printf("LOCKFN must be set before any ATs in the config file!\n");
-		fatalx(EXIT_FAILURE, "LOCKFN must be set before any ATs in the config file!");
-	}
-
-	/* check upsname: does this apply to us? */
-	if (strcmp(upsname, un) != 0)
-		if (strcmp(un, "*") != 0)
-			return;		/* not for us, and not the wildcard */
-
-	/* see if the current notify type matches the one from the .conf */
-	if (strcasecmp(notify_type, ntype) != 0)
+		conf_fatal("LOCKFN must be set before any ATs in the config file!");
 		return;
-
-	/* if command is valid, send it to the daemon (which may start it) */
+	}
 
 	if (!strcmp(cmd, "START-TIMER")) {
-		sendcmd("START", ca1, ca2);
-		return;
-	}
+		if (!ca2) {
+			upslogx(LOG_ERR, "Missing length for timer %s", ca1);
+			return;
+		}
 
-	if (!strcmp(cmd, "CANCEL-TIMER")) {
-		sendcmd("CANCEL", ca1, ca2);
-		return;
-	}
+		action = AT_START_TIMER;
 
-	if (!strcmp(cmd, "EXECUTE")) {
-		if (ca1 == '\0') {
+	} else if (!strcmp(cmd, "CANCEL-TIMER")) {
+		action = AT_CANCEL_TIMER;
+
+	} else if (!strcmp(cmd, "EXECUTE")) {
+		if (ca1[0] == '\0') {
 			upslogx(LOG_ERR, "Empty EXECUTE command argument");
 			return;
 		}
 
-		if (verbose)
-			upslogx(LOG_INFO, "Executing command: %s", ca1);
+		action = AT_EXECUTE;
 
-		exec_cmd(ca1);
+	} else {
+		upslogx(LOG_ERR, "Invalid command: %s", cmd);
 		return;
 	}
 
-	upslogx(LOG_ERR, "Invalid command: %s", cmd);
+	/* keep the rules in the order of the config file */
+	for (atptr = &athead; *atptr; atptr = &(*atptr)->next)
+		;
+
+	at = xcalloc(1, sizeof(*at));
+	at->ntype = xstrdup(ntype);
+	at->upsname = xstrdup(un);
+	at->action = action;
+	at->ca1 = xstrdup(ca1);
+	at->ca2 = ca2 ? xstrdup(ca2) : NULL;
+
+	*atptr = at;
+}
+
+static void free_rules(at_t *at)
+{
+	at_t	*atnext;
+
+	for (; at != NULL; at = atnext) {
+		atnext = at->next;
+
+		free(at->ntype);
+		free(at->upsname);
+		free(at->ca1);
+		free(at->ca2);
+		free(at);
+	}
+}
+
+static void run_rules(const char *un, const char *ntype)
+{
+	at_t	*at;
+
+	for (at = athead; at != NULL; at = at->next) {
+
+		/* check upsname: does this apply to us? */
+		if (strcmp(at->upsname, un) != 0)
+			if (strcmp(at->upsname, "*") != 0)
+				continue;	/* not for us, and not the wildcard */
+
+		/* see if the current notify type matches the one from the .conf */
+		if (strcasecmp(at->ntype, ntype) != 0)
+			continue;
+
+		switch (at->action)
+		{
+		case AT_START_TIMER:
+			/* the daemon handles it, and may have to be started */
+			if (is_daemon)
+				start_timer(at->ca1, at->ca2);
+			else
+				sendcmd("START", at->ca1, at->ca2);
+			break;
+
+		case AT_CANCEL_TIMER:
+			if (is_daemon)
+				cancel_timer(at->ca1, at->ca2);
+			else
+				sendcmd("CANCEL", at->ca1, at->ca2);
+			break;
+
+		case AT_EXECUTE:
+			if (verbose)
+				upslogx(LOG_INFO, "Executing command: %s", at->ca1);
+
+			exec_cmd(at->ca1, un, ntype);
+			break;
+		}
+	}
 }
 
 static int conf_arg(int numargs, char **arg)
@@ -816,18 +1081,21 @@ static int conf_arg(int numargs, char **arg)
 
 	/* CMDSCRIPT <scriptname> */
 	if (!strcmp(arg[0], "CMDSCRIPT")) {
+		free(cmdscript);
 		cmdscript = xstrdup(arg[1]);
 		return 1;
 	}
 
 	/* PIPEFN <pipename> */
 	if (!strcmp(arg[0], "PIPEFN")) {
+		free(pipefn);
 		pipefn = xstrdup(arg[1]);
 		return 1;
 	}
 
 	/* LOCKFN <filename> */
 	if (!strcmp(arg[0], "LOCKFN")) {
+		free(lockfn);
 		lockfn = xstrdup(arg[1]);
 		return 1;
 	}
@@ -866,8 +1134,9 @@ static void checkconf(void)
 	pconf_init(&ctx, upssched_err);
 
 	if (!pconf_file_begin(&ctx, fn)) {
+		conf_fatal(ctx.errmsg);
 		pconf_finish(&ctx);
-		fatalx(EXIT_FAILURE, "%s", ctx.errmsg);
+		return;
 	}
 
 	while (pconf_file_next(&ctx)) {
@@ -898,16 +1167,105 @@ static void checkconf(void)
 	pconf_finish(&ctx);
 }
 
+/* SIGHUP in the daemon: read the rules again */
+static void reload_conf(void)
+{
+	at_t	*oldrules = athead;
+	char	*oldscript = cmdscript, *sockfn = pipefn, *oldlock = lockfn;
+
+	upslogx(LOG_INFO, "Reloading upssched.conf");
+
+	athead = NULL;
+	cmdscript = pipefn = lockfn = NULL;
+
+	reloading = 1;
+	conf_failed = 0;
+	checkconf();
+	reloading = 0;
+
+	if (conf_failed) {
+		upslogx(LOG_WARNING, "Keeping the previous rules");
+
+		free_rules(athead);
+		free(cmdscript);
+
+		athead = oldrules;
+		cmdscript = oldscript;
+	} else {
+		/* we're already listening there */
+		if (!pipefn || strcmp(pipefn, sockfn))
+			upslogx(LOG_WARNING, "PIPEFN changed, restart upssched to use it");
+
+		free_rules(oldrules);
+		free(oldscript);
+	}
+
+	/* the daemon keeps the socket and lock it was started with */
+	free(pipefn);
+	free(lockfn);
+	pipefn = sockfn;
+	lockfn = oldlock;
+}
+
+static void help(const char *prog)
+{
+	printf("upsmon's scheduling helper for offset timers.\n");
+
+	printf("\nusage: %s [-h] [-d]\n", prog);
+	printf("\n");
+
+	printf("  -d		- start the timer daemon, and keep it running\n");
+	printf("  -h		- display this help text\n");
+	printf("\n");
+	printf("Otherwise, %s is run from upsmon with UPSNAME and NOTIFYTYPE set.\n", prog);
+
+	exit(EXIT_SUCCESS);
+}
+
 int main(int argc, char **argv)
 {
+	int	i, fd;
 	const char	*prog = xbasename(argv[0]);
+	const char	*upsname, *notify_type;
 
 	verbose = 1;		/* TODO: remove when done testing */
 
+	while ((i = getopt(argc, argv, "+hd")) != -1) {
+		switch (i)
+		{
+		case 'd':
+			persistent = 1;
+			break;
+
+		case 'h':
+		default:
+			help(prog);
+			break;
+		}
+	}
+
 	/* normally we don't have stderr, so get this going to syslog early */
 	open_syslog(prog);
 	syslogbit_set();
 
+	if (persistent) {
+		checkconf();
+
+		if (!pipefn)
+			fatalx(EXIT_FAILURE, "PIPEFN must be set in upssched.conf");
+
+		fd = try_connect();
+
+		if (fd != -1) {
+			close(fd);
+			fatalx(EXIT_FAILURE, "A timer daemon is already listening on %s", pipefn);
+		}
+
+		/* the parent returns once the daemon is listening */
+		start_daemon(-1);
+		exit(EXIT_SUCCESS);
+	}
+
 	upsname = getenv("UPSNAME");
 	notify_type = getenv("NOTIFYTYPE");
 
@@ -920,5 +1278,7 @@ int main(int argc, char **argv)
 	/* see if this matches anything in the config file */
 	checkconf();
 
+	run_rules(upsname, notify_type);
+
 	exit(EXIT_SUCCESS);
 }
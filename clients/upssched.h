@@ -19,6 +19,20 @@ typedef struct conn_s {
 	struct conn_s	*next;
 } conn_t;
 
+#define AT_START_TIMER	1
+#define AT_CANCEL_TIMER	2
+#define AT_EXECUTE	3
+
+/* AT rules from upssched.conf */
+typedef struct at_s {
+	char	*ntype;
+	char	*upsname;
+	int	action;
+	char	*ca1;
+	char	*ca2;
+	struct at_s	*next;
+} at_t;
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
@@ -31,7 +31,7 @@
 #define MAX_PARSE_ARGS 16
 
 static char	*monhost = NULL;
-static int	use_celsius = 1, refreshdelay = -1, treemode = 0;
+static int	use_celsius = 1, refreshdelay = -1, treemode = 0, jsonmode = 0;
 
 	/* from cgilib's checkhost() */
 static char	*monhostdesc = NULL;
@@ -41,8 +41,13 @@ static char	*upsname, *hostname;
 static char	*upsimgpath="upsimage.cgi", *upsstatpath="upsstats.cgi";
 static UPSCONN_t	ups;
 
-static FILE	*tf;
-static long	forofs = 0;
+	/* currups is served from the cgilib snapshot cache */
+static int	use_snapshot = 0;
+
+	/* template being displayed, current op and FOREACHUPS loop start */
+static tmpl_t	*tmpl = NULL;
+static size_t	curop = 0, forop = 0;
+static int	forjump = 0;
 
 static ulist_t	*ulhead = NULL, *currups = NULL;
 
@@ -67,6 +72,9 @@ void parsearg(char *var, char *value)
 		/* FIXME: Validate that treemode is allowed */
 		treemode = 1;
 	}
+
+	if (!strcmp(var, "json"))
+		jsonmode = 1;
 }
 
 static void report_error(void)
@@ -80,7 +88,7 @@ static void report_error(void)
 /* make sure we're actually connected to upsd */
 static int check_ups_fd(int do_report)
 {
-	if (upscli_fd(&ups) == -1) {
+	if ((!use_snapshot) && (upscli_fd(&ups) == -1)) {
 		if (do_report)
 			report_error();
 
@@ -106,10 +114,24 @@ static int get_var(const char *var, char *buf, size_t buflen, int verbose)
 	unsigned int	numq, numa;
 	const	char	*query[4];
 	char	**answer;
+	const	char	*val;
 
 	if (!check_ups_fd(1))
 		return 0;
 
+	if (use_snapshot) {
+		val = cgicache_get(currups->sys, var);
+
+		if (!val) {
+			if (verbose)
+				printf("Not supported\n");
+			return 0;
+		}
+
+		snprintf(buf, buflen, "%s", val);
+		return 1;
+	}
+
 	if (!upsname) {
 		if (verbose)
 			printf("[No UPS name specified]\n");
@@ -345,7 +367,7 @@ static int do_img(char *buf)
 	return 0;
 }
 
-static void ups_connect(void)
+static void upsd_connect(void)
 {
 	static ulist_t	*lastups = NULL;
 	char	*newups, *newhost;
@@ -402,6 +424,21 @@ static void ups_connect(void)
 	lastups = currups;
 }
 
+static void ups_connect(void)
+{
+	/* a recent snapshot saves the connection to upsd */
+	if (cgicache_fresh(currups->sys)) {
+		use_snapshot = 1;
+		return;
+	}
+
+	upsd_connect();
+
+	/* fetch everything at once rather than one GET per variable */
+	use_snapshot = ((upscli_fd(&ups) != -1)
+		&& (cgicache_update(currups->sys, &ups, upsname)));
+}
+
 static void do_hostlink(void)
 {
 	if (!currups) {
@@ -632,182 +669,277 @@ static void do_statuscolor(void)
 	}
 }
 
-static int do_command(char *cmd)
+static void cmd_var(char *arg)
 {
-	/* ending an if block? */
-	if (!strcmp(cmd, "ENDIF")) {
-		skip_clause = 0;
-		skip_block = 0;
-		return 1;
-	}
+	parse_var(arg);
+}
 
-	/* Skipping a block means skip until ENDIF, so... */
-	if (skip_block) {
-		return 1;
-	}
+static void cmd_host(char *arg)
+{
+	printf("%s", currups->sys);
+}
 
-	/* Toggle state when we run across ELSE */
-	if (!strcmp(cmd, "ELSE")) {
-		if (skip_clause) {
-			skip_clause = 0;
-		} else {
-			skip_block = 1;
-		}
-		return 1;
-	}
+static void cmd_hostdesc(char *arg)
+{
+	printf("%s", currups->desc);
+}
 
-	/* don't do any commands if skipping a section */
-	if (skip_clause == 1) {
-		return 1;
-	}
+static void cmd_runtime(char *arg)
+{
+	do_runtime();
+}
 
-	if (!strncmp(cmd, "VAR ", 4)) {
-		parse_var(&cmd[4]);
-		return 1;
-	}
+static void cmd_status(char *arg)
+{
+	do_status();
+}
 
-	if (!strcmp(cmd, "HOST")) {
-		printf("%s", currups->sys);
-		return 1;
-	}
+static void cmd_statuscolor(char *arg)
+{
+	do_statuscolor();
+}
 
-	if (!strcmp(cmd, "HOSTDESC")) {
-		printf("%s", currups->desc);
-		return 1;
-	}
+static void cmd_tempf(char *arg)
+{
+	use_celsius = 0;
+}
 
-	if (!strcmp(cmd, "RUNTIME")) {
-		do_runtime();
-		return 1;
-	}
+static void cmd_tempc(char *arg)
+{
+	use_celsius = 1;
+}
 
-	if (!strcmp(cmd, "STATUS")) {
-		do_status();
-		return 1;
-	}
+static void cmd_date(char *arg)
+{
+	do_date(arg);
+}
 
-	if (!strcmp(cmd, "STATUSCOLOR")) {
-		do_statuscolor();
-		return 1;
-	}
+static void cmd_img(char *arg)
+{
+	do_img(arg);
+}
 
-	if (!strcmp(cmd, "TEMPF")) {
-		use_celsius = 0;
-		return 1;
-	}
+static void cmd_version(char *arg)
+{
+	printf("%s", UPS_VERSION);
+}
 
-	if (!strcmp(cmd, "TEMPC")) {
-		use_celsius = 1;
-		return 1;
+static void cmd_refresh(char *arg)
+{
+	if (refreshdelay > 0) {
+		printf("<META HTTP-EQUIV=\"Refresh\" CONTENT=\"%d\">", refreshdelay);
 	}
+}
 
-	if (!strncmp(cmd, "DATE ", 5)) {
-		return do_date(&cmd[5]);
-	}
+static void cmd_foreachups(char *arg)
+{
+	size_t	i;
 
-	if (!strncmp(cmd, "IMG ", 4)) {
-		return do_img(&cmd[4]);
+	/* like the template file, restart with the next line */
+	for (i = curop + 1; i < tmpl->numops; i++) {
+		if (tmpl->ops[i].line != tmpl->ops[curop].line)
+			break;
 	}
 
-	if (!strcmp(cmd, "VERSION")) {
-		printf("%s", UPS_VERSION);
-		return 1;
-	}
+	forop = i;
 
-	if (!strcmp(cmd, "REFRESH")) {
-		if (refreshdelay > 0) {
-			printf("<META HTTP-EQUIV=\"Refresh\" CONTENT=\"%d\">", refreshdelay);
-		}
-		return 1;
+	currups = ulhead;
+	ups_connect();
+}
+
+static void cmd_endfor(char *arg)
+{
+	/* if not in a for, ignore this */
+	if (forop == 0) {
+		return;
 	}
 
-	if (!strcmp(cmd, "FOREACHUPS")) {
-		forofs = ftell(tf);
+	currups = currups->next;
 
-		currups = ulhead;
+	/* like the template file, finish this line before going back */
+	if (currups) {
+		forjump = 1;
 		ups_connect();
-		return 1;
 	}
+}
 
-	if (!strcmp(cmd, "ENDFOR")) {
+static void cmd_hostlink(char *arg)
+{
+	do_hostlink();
+}
 
-		/* if not in a for, ignore this */
-		if (forofs == 0) {
-			return 1;
-		}
+static void cmd_treelink(char *arg)
+{
+	do_treelink();
+}
 
-		currups = currups->next;
+static void cmd_ifsupp(char *arg)
+{
+	do_ifsupp(arg, NULL);
+}
 
-		if (currups) {
-			fseek(tf, forofs, SEEK_SET);
-			ups_connect();
-		}
+static void cmd_upstemp(char *arg)
+{
+	do_temp("ups.temperature");
+}
 
-		return 1;
-	}
+static void cmd_batttemp(char *arg)
+{
+	do_temp("battery.temperature");
+}
 
-	if (!strcmp(cmd, "HOSTLINK")) {
-		do_hostlink();
-		return 1;
-	}
+static void cmd_ambtemp(char *arg)
+{
+	do_temp("ambient.temperature");
+}
 
-	if (!strcmp(cmd, "TREELINK")) {
-		do_treelink();
-		return 1;
-	}
+static void cmd_degrees(char *arg)
+{
+	do_degrees();
+}
 
-	if (!strncmp(cmd, "IFSUPP ", 7)) {
-		do_ifsupp(&cmd[7], NULL);
-		return 1;
-	}
+static void cmd_ifeq(char *arg)
+{
+	do_ifeq(arg);
+}
 
-	if (!strcmp(cmd, "UPSTEMP")) {
-		do_temp("ups.temperature");
-		return 1;
-	}
+static void cmd_ifbetween(char *arg)
+{
+	do_ifbetween(arg);
+}
 
-	if (!strcmp(cmd, "BATTTEMP")) {
-		do_temp("battery.temperature");
-		return 1;
-	}
+static void cmd_upsstatpath(char *arg)
+{
+	do_upsstatpath(arg);
+}
 
-	if (!strcmp(cmd, "AMBTEMP")) {
-		do_temp("ambient.temperature");
-		return 1;
+static void cmd_upsimgpath(char *arg)
+{
+	do_upsimgpath(arg);
+}
+
+/* template commands: @NAME@, or @NAME <arg>@ when hasarg is set */
+static struct {
+	const	char	*name;
+	int	hasarg;
+	void	(*func)(char *arg);
+}	cmdtab[] =
+{
+	{ "ENDIF",		0,	NULL			},
+	{ "ELSE",		0,	NULL			},
+	{ "VAR",		1,	cmd_var			},
+	{ "HOST",		0,	cmd_host		},
+	{ "HOSTDESC",		0,	cmd_hostdesc		},
+	{ "RUNTIME",		0,	cmd_runtime		},
+	{ "STATUS",		0,	cmd_status		},
+	{ "STATUSCOLOR",	0,	cmd_statuscolor		},
+	{ "TEMPF",		0,	cmd_tempf		},
+	{ "TEMPC",		0,	cmd_tempc		},
+	{ "DATE",		1,	cmd_date		},
+	{ "IMG",		1,	cmd_img			},
+	{ "VERSION",		0,	cmd_version		},
+	{ "REFRESH",		0,	cmd_refresh		},
+	{ "FOREACHUPS",		0,	cmd_foreachups		},
+	{ "ENDFOR",		0,	cmd_endfor		},
+	{ "HOSTLINK",		0,	cmd_hostlink		},
+	{ "TREELINK",		0,	cmd_treelink		},
+	{ "IFSUPP",		1,	cmd_ifsupp		},
+	{ "UPSTEMP",		0,	cmd_upstemp		},
+	{ "BATTTEMP",		0,	cmd_batttemp		},
+	{ "AMBTEMP",		0,	cmd_ambtemp		},
+	{ "DEGREES",		0,	cmd_degrees		},
+	{ "IFEQ",		1,	cmd_ifeq		},
+	{ "IFBETWEEN",		1,	cmd_ifbetween		},
+	{ "UPSSTATSPATH",	1,	cmd_upsstatpath		},
+	{ "UPSIMAGEPATH",	1,	cmd_upsimgpath		},
+	{ NULL,			0,	NULL			}
+};
+
+#define CMD_ENDIF	0
+#define CMD_ELSE	1
+
+/* resolve a command to its cmdtab index, and split its argument */
+static int find_command(const char *cmd, char **arg)
+{
+	int	i;
+	size_t	len;
+	const	char	*sp;
+
+	sp = strchr(cmd, ' ');
+	len = sp ? (size_t)(sp - cmd) : strlen(cmd);
+
+	for (i = 0; cmdtab[i].name != NULL; i++) {
+		if ((strlen(cmdtab[i].name) != len) || (strncmp(cmdtab[i].name, cmd, len) != 0))
+			continue;
+
+		if (cmdtab[i].hasarg != (sp != NULL))
+			continue;
+
+		*arg = xstrdup(sp ? sp + 1 : "");
+		return i;
 	}
 
-	if (!strcmp(cmd, "DEGREES")) {
-		do_degrees();
-		return 1;
+	return OP_UNKNOWN;
+}
+
+static void do_command(const tmplop_t *op)
+{
+	char	arg[SMALLBUF];
+
+	/* ending an if block? */
+	if (op->type == CMD_ENDIF) {
+		skip_clause = 0;
+		skip_block = 0;
+		return;
 	}
 
-	if (!strncmp(cmd, "IFEQ ", 5)) {
-		do_ifeq(&cmd[5]);
-		return 1;
+	/* Skipping a block means skip until ENDIF, so... */
+	if (skip_block) {
+		return;
 	}
 
-	if (!strncmp(cmd, "IFBETWEEN ", 10)) {
-		do_ifbetween(&cmd[10]);
-		return 1;
+	/* Toggle state when we run across ELSE */
+	if (op->type == CMD_ELSE) {
+		if (skip_clause) {
+			skip_clause = 0;
+		} else {
+			skip_block = 1;
+		}
+		return;
 	}
 
-	if (!strncmp(cmd, "UPSSTATSPATH ", 13)) {
-		do_upsstatpath(&cmd[13]);
-		return 1;
+	/* don't do any commands if skipping a section */
+	if (skip_clause == 1) {
+		return;
 	}
 
-	if (!strncmp(cmd, "UPSIMAGEPATH ", 13)) {
-		do_upsimgpath(&cmd[13]);
-		return 1;
+	/* commands may modify their argument, which is reused by loops */
+	snprintf(arg, sizeof(arg), "%s", op->arg);
+	cmdtab[op->type].func(arg);
+}
+
+static void add_op(tmpl_t *t, int type, int line, const char *arg, size_t len)
+{
+	tmplop_t	*op;
+
+	if (t->numops == t->maxops) {
+		t->maxops = (t->maxops == 0) ? 128 : t->maxops * 2;
+		t->ops = xrealloc(t->ops, t->maxops * sizeof(tmplop_t));
 	}
 
-	return 0;
+	op = &t->ops[t->numops++];
+	op->type = type;
+	op->line = line;
+	op->arg = xmalloc(len + 1);
+	memcpy(op->arg, arg, len);
+	op->arg[len] = '\0';
 }
 
-static void parse_line(const char *buf)
+/* split a line in text and @COMMAND@ ops */
+static void compile_line(tmpl_t *t, const char *buf, int line)
 {
-	char	cmd[SMALLBUF];
-	int	i, len, do_cmd = 0;
+	char	cmd[SMALLBUF], *arg;
+	int	i, len, type, do_cmd = 0;
 
 	for (i = 0; buf[i]; i += len) {
 
@@ -815,7 +947,13 @@ static void parse_line(const char *buf)
 
 		if (len == 0) {
 			if (do_cmd) {
-				do_command(cmd);
+				type = find_command(cmd, &arg);
+
+				if (type != OP_UNKNOWN) {
+					add_op(t, type, line, arg, strlen(arg));
+					free(arg);
+				}
+
 				do_cmd = 0;
 			} else {
 				cmd[0] = '\0';
@@ -830,25 +968,143 @@ static void parse_line(const char *buf)
 			continue;
 		}
 
-		if (skip_clause || skip_block) {
-			/* ignore this */
-			continue;
+		add_op(t, OP_TEXT, line, &buf[i], len);
+	}
+}
+
+static void free_template(tmpl_t *t)
+{
+	size_t	i;
+
+	for (i = 0; i < t->numops; i++)
+		free(t->ops[i].arg);
+
+	free(t->ops);
+	free(t);
+}
+
+/* compiled templates are cached as:
+   "upsstats-template <mtime> <size>" then "<line> <command|-> <len>" lines,
+   each followed by <len> bytes of text or command argument */
+
+static tmpl_t *load_compiled(const char *cachefn, const struct stat *fs)
+{
+	FILE	*f;
+	char	hdr[SMALLBUF], name[SMALLBUF], *arg;
+	long	mtime, size;
+	int	line, type;
+	unsigned long	ulen;
+	size_t	len;
+	tmpl_t	*t;
+
+	f = fopen(cachefn, "rb");
+
+	if (!f)
+		return NULL;
+
+	if ((!fgets(hdr, sizeof(hdr), f))
+		|| (sscanf(hdr, "upsstats-template %ld %ld", &mtime, &size) != 2)
+		|| (mtime != (long)fs->st_mtime) || (size != (long)fs->st_size)) {
+		fclose(f);
+		return NULL;
+	}
+
+	t = xcalloc(1, sizeof(tmpl_t));
+
+	while (fgets(hdr, sizeof(hdr), f)) {
+
+		if (sscanf(hdr, "%d %511s %lu", &line, name, &ulen) != 3)
+			break;
+
+		/* nothing is longer than the template itself */
+		if (ulen > (unsigned long)size)
+			break;
+
+		len = ulen;
+
+		arg = xmalloc(len + 1);
+
+		if (fread(arg, 1, len, f) != len) {
+			free(arg);
+			break;
 		}
 
-		/* pass it trough */
-		printf("%.*s", len, &buf[i]);
+		arg[len] = '\0';
+
+		if (!strcmp(name, "-")) {
+			type = OP_TEXT;
+		} else {
+			for (type = 0; cmdtab[type].name != NULL; type++)
+				if (!strcmp(cmdtab[type].name, name))
+					break;
+
+			/* written by another version: recompile */
+			if (cmdtab[type].name == NULL) {
+				free(arg);
+				break;
+			}
+		}
+
+		add_op(t, type, line, arg, len);
+		free(arg);
+	}
+
+	if (!feof(f)) {
+		/* truncated or unknown contents */
+		fclose(f);
+		free_template(t);
+		return NULL;
 	}
+
+	fclose(f);
+
+	return t;
 }
 
-static void display_template(const char *tfn)
+static void save_compiled(const tmpl_t *t, const char *cachefn,
+	const struct stat *fs)
+{
+	FILE	*f;
+	char	tmpfn[LARGEBUF];
+	size_t	i, len;
+
+	snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", cachefn, (long)getpid());
+
+	f = fopen(tmpfn, "wb");
+
+	if (!f)
+		return;
+
+	fprintf(f, "upsstats-template %ld %ld\n", (long)fs->st_mtime,
+		(long)fs->st_size);
+
+	for (i = 0; i < t->numops; i++) {
+		len = strlen(t->ops[i].arg);
+
+		fprintf(f, "%d %s %lu\n", t->ops[i].line,
+			(t->ops[i].type == OP_TEXT) ? "-" : cmdtab[t->ops[i].type].name,
+			(unsigned long)len);
+		fwrite(t->ops[i].arg, 1, len, f);
+	}
+
+	if ((fclose(f) != 0) || (rename(tmpfn, cachefn) != 0))
+		unlink(tmpfn);
+}
+
+/* get the template as a list of ops, from the cache if it's up to date */
+static tmpl_t *compile_template(const char *tfn)
 {
-	char	fn[SMALLBUF], buf[LARGEBUF];	
+	char	fn[SMALLBUF], cachefn[LARGEBUF], buf[LARGEBUF];
+	int	line = 0;
+	FILE	*tf;
+	struct stat	fs;
+	tmpl_t	*t;
 
 	snprintf(fn, sizeof(fn), "%s/%s", confpath(), tfn);
 
 	tf = fopen(fn, "r");
 
-	if (!tf) {
+	if ((!tf) || (fstat(fileno(tf), &fs) != 0)) {
 		fprintf(stderr, "upsstats: Can't open %s: %s\n", fn, strerror(errno));
 
 		printf("Error: can't open template file (%s)\n", tfn);
@@ -856,33 +1112,98 @@ static void display_template(const char *tfn)
 		exit(EXIT_FAILURE);
 	}
 
+	cachefn[0] = '\0';
+
+	if (cgicache_dir()) {
+		snprintf(cachefn, sizeof(cachefn), "%s/upsstats-%s", cgicache_dir(), tfn);
+
+		t = load_compiled(cachefn, &fs);
+
+		if (t) {
+			fclose(tf);
+			return t;
+		}
+	}
+
+	t = xcalloc(1, sizeof(tmpl_t));
+
 	while (fgets(buf, sizeof(buf), tf)) {
-		parse_line(buf);
+		compile_line(t, buf, line++);
 	}
 
 	fclose(tf);
+
+	if (cachefn[0])
+		save_compiled(t, cachefn, &fs);
+
+	return t;
+}
+
+static void display_template(const char *tfn)
+{
+	const	tmplop_t	*op;
+
+	tmpl = compile_template(tfn);
+
+	for (curop = 0; curop < tmpl->numops; curop++) {
+		op = &tmpl->ops[curop];
+
+		if (op->type != OP_TEXT) {
+			do_command(op);
+		} else if ((!skip_clause) && (!skip_block)) {
+			/* pass it trough */
+			fputs(op->arg, stdout);
+		}
+
+		/* end of line after ENDFOR: loop back */
+		if ((forjump) && ((curop + 1 == tmpl->numops)
+			|| (tmpl->ops[curop + 1].line != op->line))) {
+			forjump = 0;
+			curop = forop - 1;
+		}
+	}
+
+	free_template(tmpl);
+	tmpl = NULL;
+}
+
+static void display_tree_var(const char *name, const char *value)
+{
+	printf("<TR BGCOLOR=\"#60B0B0\" ALIGN=\"LEFT\">\n");
+
+	printf("<TD>%s</TD>\n", name);
+	printf("<TD>:</TD>\n");
+	printf("<TD>%s<br></TD>\n", value);
+
+	printf("</TR>\n");
 }
 
 static void display_tree(int verbose)
 {
-	unsigned int	numq, numa;
+	unsigned int	numq = 0, numa;
 	const	char	*query[4];
 	char	**answer;
+	const	cgivar_t	*vars = NULL;
+	size_t	i, numvars = 0;
 
-	if (!upsname) {
-		if (verbose)
-			printf("[No UPS name specified]\n");
-		return;
-	}
+	if (use_snapshot) {
+		numvars = cgicache_vars(currups->sys, &vars);
+	} else {
+		if (!upsname) {
+			if (verbose)
+				printf("[No UPS name specified]\n");
+			return;
+		}
 
-	query[0] = "VAR";
-	query[1] = upsname;
-	numq = 2;
+		query[0] = "VAR";
+		query[1] = upsname;
+		numq = 2;
 
-	if (upscli_list_start(&ups, numq, query) < 0) {
-		if (verbose)
-			report_error();
-		return;
+		if (upscli_list_start(&ups, numq, query) < 0) {
+			if (verbose)
+				report_error();
+			return;
+		}
 	}
 
 	printf("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0 Transitional//EN\"\n");
@@ -904,7 +1225,10 @@ static void display_tree(int verbose)
 
 	printf("<TR><TH COLSPAN=3 BGCOLOR=\"#60B0B0\"></TH></TR>\n");
 
-	while (upscli_list_next(&ups, numq, query, &numa, &answer) == 1) {
+	for (i = 0; i < numvars; i++)
+		display_tree_var(vars[i].name, vars[i].value);
+
+	while ((!use_snapshot) && (upscli_list_next(&ups, numq, query, &numa, &answer) == 1)) {
 
 		/* VAR <upsname> <varname> <val> */
 		if (numa < 4) {
@@ -914,13 +1238,7 @@ static void display_tree(int verbose)
 			return;
 		}
 
-		printf("<TR BGCOLOR=\"#60B0B0\" ALIGN=\"LEFT\">\n");
-	
-		printf("<TD>%s</TD>\n", answer[2]);
-		printf("<TD>:</TD>\n");
-		printf("<TD>%s<br></TD>\n", answer[3]);
-
-		printf("</TR>\n");
+		display_tree_var(answer[2], answer[3]);
 	}
 
 	printf("</TABLE>\n");
@@ -930,6 +1248,205 @@ static void display_tree(int verbose)
 	printf("</BODY></HTML>\n");
 }
 
+static void json_string(const char *str)
+{
+	const	unsigned char	*ptr;
+
+	putchar('"');
+
+	for (ptr = (const unsigned char *)str; *ptr; ptr++) {
+		if ((*ptr == '"') || (*ptr == '\\'))
+			printf("\\%c", *ptr);
+		else if (*ptr < 0x20)
+			printf("\\u%04x", *ptr);
+		else
+			putchar(*ptr);
+	}
+
+	putchar('"');
+}
+
+/* find the connection to upsd on <hostname>:<port>, opening it if needed */
+static upsdlist_t *json_upsd(const char *hostname, int port)
+{
+	static upsdlist_t	*upsdhead = NULL;
+	upsdlist_t	*tmp;
+
+	for (tmp = upsdhead; tmp; tmp = tmp->next) {
+		if ((!strcmp(tmp->hostname, hostname)) && (tmp->port == port))
+			return tmp;
+	}
+
+	tmp = xcalloc(1, sizeof(upsdlist_t));
+	tmp->hostname = xstrdup(hostname);
+	tmp->port = port;
+	tmp->next = upsdhead;
+	upsdhead = tmp;
+
+	if (upscli_connect(&tmp->conn, hostname, port, 0) < 0)
+		fprintf(stderr, "upsstats: can't connect to %s:%d: %s\n",
+			hostname, port, upscli_strerror(&tmp->conn));
+
+	return tmp;
+}
+
+/* read the LIST VAR answer sent by upsd for <upsname> into the snapshot
+   of <sys>, returns NULL or an error message */
+static const char *json_read_list(upsdlist_t *upsd, const char *sys,
+	const char *upsname)
+{
+	static char	buf[UPSCLI_NETBUF_LEN];
+	char	begin[SMALLBUF];
+	PCONF_CTX_t	ctx;
+
+	/* still holds the reason of the connection failure */
+	if (upscli_fd(&upsd->conn) == -1)
+		return upscli_strerror(&upsd->conn);
+
+	if (upscli_readline(&upsd->conn, buf, sizeof(buf)) != 0)
+		return upscli_strerror(&upsd->conn);
+
+	if (!strncmp(buf, "ERR ", 4))
+		return &buf[4];
+
+	snprintf(begin, sizeof(begin), "BEGIN LIST VAR %s", upsname);
+
+	if (strncmp(buf, begin, strlen(begin)) != 0)
+		return "Invalid response";
+
+	pconf_init(&ctx, NULL);
+	cgicache_clear(sys);
+
+	while (upscli_readline(&upsd->conn, buf, sizeof(buf)) == 0) {
+
+		if (!pconf_line(&ctx, buf)) {
+			pconf_finish(&ctx);
+
+			/* the next reply may follow on this connection */
+			while (upscli_readline(&upsd->conn, buf, sizeof(buf)) == 0) {
+				if (!strncmp(buf, "END LIST VAR", 12))
+					return "Parse error in the variable list";
+			}
+
+			return upscli_strerror(&upsd->conn);
+		}
+
+		if ((ctx.numargs > 0) && (!strcmp(ctx.arglist[0], "END"))) {
+			pconf_finish(&ctx);
+			cgicache_save(sys);
+			return NULL;
+		}
+
+		/* VAR <upsname> <varname> <val> */
+		if ((ctx.numargs < 4) || (strcmp(ctx.arglist[0], "VAR") != 0))
+			continue;
+
+		cgicache_add(sys, ctx.arglist[2], ctx.arglist[3]);
+	}
+
+	pconf_finish(&ctx);
+
+	return upscli_strerror(&upsd->conn);
+}
+
+/* dump all variables of all UPSes as a JSON document */
+static void display_json(void)
+{
+	char	*newups, *newhost, cmd[SMALLBUF];
+	const	char	*err;
+	int	newport;
+	size_t	i, numvars;
+	const	cgivar_t	*vars;
+	ulist_t	*tmp;
+	upsdlist_t	*upsd;
+
+	/* first send all requests so that the upsd servers work on them
+	   concurrently, then collect the answers in the same order */
+	for (tmp = ulhead; tmp; tmp = tmp->next) {
+
+		/* the second pass must read exactly the replies asked for here,
+		   even if the snapshot is refreshed by someone else meanwhile */
+		if (cgicache_fresh(tmp->sys)) {
+			tmp->json = JSON_CACHED;
+			continue;
+		}
+
+		tmp->json = JSON_FAILED;
+
+		newups = newhost = NULL;
+
+		if (upscli_splitname(tmp->sys, &newups, &newhost, &newport) != 0)
+			continue;
+
+		upsd = json_upsd(newhost, newport);
+
+		if (upscli_fd(&upsd->conn) != -1) {
+			snprintf(cmd, sizeof(cmd), "LIST VAR %s\n", newups);
+
+			if (upscli_sendline(&upsd->conn, cmd, strlen(cmd)) == 0)
+				tmp->json = JSON_SENT;
+		}
+
+		free(newups);
+		free(newhost);
+	}
+
+	printf("{\n\"ups\": [");
+
+	for (tmp = ulhead; tmp; tmp = tmp->next) {
+
+		err = NULL;
+
+		if (tmp->json != JSON_CACHED) {
+
+			newups = newhost = NULL;
+
+			if (upscli_splitname(tmp->sys, &newups, &newhost, &newport) != 0) {
+				err = "Invalid UPS definition";
+			} else {
+				upsd = json_upsd(newhost, newport);
+
+				if (tmp->json == JSON_SENT)
+					err = json_read_list(upsd, tmp->sys, newups);
+				else if (upscli_fd(&upsd->conn) == -1)
+					err = upscli_strerror(&upsd->conn);
+				else
+					err = "Can't send the request";
+			}
+
+			free(newups);
+			free(newhost);
+		}
+
+		printf("%s\n{\"system\": ", (tmp == ulhead) ? "" : ",");
+		json_string(tmp->sys);
+		printf(", \"description\": ");
+		json_string(tmp->desc);
+
+		if (err) {
+			printf(", \"error\": ");
+			json_string(err);
+			printf("}");
+			continue;
+		}
+
+		printf(", \"vars\": {");
+
+		numvars = cgicache_vars(tmp->sys, &vars);
+
+		for (i = 0; i < numvars; i++) {
+			printf("%s\n  ", (i == 0) ? "" : ",");
+			json_string(vars[i].name);
+			printf(": ");
+			json_string(vars[i].value);
+		}
+
+		printf("\n}}");
+	}
+
+	printf("\n]\n}\n");
+}
+
 static void add_ups(char *sys, char *desc)
 {
 	ulist_t	*tmp, *last;
@@ -945,6 +1462,7 @@ static void add_ups(char *sys, char *desc)
 
 	tmp->sys = xstrdup(sys);
 	tmp->desc = xstrdup(desc);
+	tmp->json = JSON_CACHED;
 	tmp->next = NULL;
 
 	if (last)
@@ -971,6 +1489,14 @@ static void load_hosts_conf(void)
 	if (!pconf_file_begin(&ctx, fn)) {
 		pconf_finish(&ctx);
 
+		/* leave something for the admin */
+		fprintf(stderr, "upsstats: %s\n", ctx.errmsg);
+
+		if (jsonmode) {
+			printf("{\"error\": \"Can't open hosts.conf\"}\n");
+			exit(EXIT_FAILURE);
+		}
+
 		printf("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0 Transitional//EN\"\n");
 		printf("	\"http://www.w3.org/TR/REC-html40/loose.dtd\">\n");
 		printf("<HTML><HEAD>\n");
@@ -979,8 +1505,6 @@ static void load_hosts_conf(void)
 		printf("Error: can't open hosts.conf\n");
 		printf("</BODY></HTML>\n");
 
-		/* leave something for the admin */
-		fprintf(stderr, "upsstats: %s\n", ctx.errmsg);
 		exit(EXIT_FAILURE);
 	}
 
@@ -998,11 +1522,23 @@ static void load_hosts_conf(void)
 		if (!strcmp(ctx.arglist[0], "MONITOR"))
 			add_ups(ctx.arglist[1], ctx.arglist[2]);
 
+		/* CACHE <path> <seconds> */
+		if (!strcmp(ctx.arglist[0], "CACHE"))
+			cgicache_conf(ctx.arglist[1], ctx.arglist[2]);
+
 	}
 
 	pconf_finish(&ctx);
 
 	if (!ulhead) {
+		/* leave something for the admin */
+		fprintf(stderr, "upsstats: no hosts to monitor\n");
+
+		if (jsonmode) {
+			printf("{\"error\": \"No hosts to monitor\"}\n");
+			exit(EXIT_FAILURE);
+		}
+
 		printf("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0 Transitional//EN\"\n");
 		printf("	\"http://www.w3.org/TR/REC-html40/loose.dtd\">\n");
 		printf("<HTML><HEAD>\n");
@@ -1011,8 +1547,6 @@ static void load_hosts_conf(void)
 		printf("Error: no hosts to monitor (check <CODE>hosts.conf</CODE>)\n");
 		printf("</BODY></HTML>\n");
 
-		/* leave something for the admin */
-		fprintf(stderr, "upsstats: no hosts to monitor\n");
 		exit(EXIT_FAILURE);
 	}
 }
@@ -1043,6 +1577,27 @@ int main(int argc, char **argv)
 {
 	extractcgiargs();
 
+	/* machine-readable dump of all variables, for dashboards */
+	if (jsonmode) {
+		printf("Content-type: application/json\n");
+		printf("Pragma: no-cache\n");
+		printf("\n");
+
+		if (monhost) {
+			if (!checkhost(monhost, &monhostdesc)) {
+				printf("{\"error\": \"Access to that host is not authorized\"}\n");
+				exit(EXIT_FAILURE);
+			}
+
+			add_ups(monhost, monhostdesc);
+		} else {
+			load_hosts_conf();
+		}
+
+		display_json();
+		exit(EXIT_SUCCESS);
+	}
+
 	printf("Content-type: text/html\n"); 
 	printf("Pragma: no-cache\n");
 	printf("\n");
@@ -23,12 +23,42 @@ extern "C" {
 /* *INDENT-ON* */
 #endif
 
+/* what display_json() did for a system in its first pass */
+#define JSON_CACHED	0	/* the snapshot was fresh */
+#define JSON_SENT	1	/* LIST VAR sent, the reply has to be read */
+#define JSON_FAILED	2	/* no request could be sent */
+
 typedef struct {
 	char	*sys;
 	char	*desc;
+	int	json;
 	void	*next;
 }	ulist_t;
 
+	/* compiled templates: text to output, or @COMMAND@ to run */
+#define OP_TEXT		-1
+#define OP_UNKNOWN	-2
+
+typedef struct {
+	int	type;		/* OP_TEXT or index in the command table */
+	int	line;		/* template line number */
+	char	*arg;		/* text or command argument */
+}	tmplop_t;
+
+typedef struct {
+	size_t	numops;
+	size_t	maxops;
+	tmplop_t	*ops;
+}	tmpl_t;
+
+	/* upsd servers queried in json mode */
+typedef struct {
+	char	*hostname;
+	int	port;
+	UPSCONN_t	conn;
+	void	*next;
+}	upsdlist_t;
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
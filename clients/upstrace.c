@@ -0,0 +1,564 @@
+/* upstrace - record the variables of a UPS into a binary trace
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* Two ways to record:
+ *
+ * - through upsd, by listing the variables every interval and storing
+ *   what changed since the previous listing
+ *
+ * - straight from the socket of a driver, which pushes every SETINFO and
+ *   DELINFO as it happens, so nothing is lost between two polls
+ *
+ * Either way, the trace only grows by the changes, and can be played back
+ * by dummy-ups or converted from and to the text .seq format.
+ */
+
+#include "common.h"
+#include "upsclient.h"
+#include "parseconf.h"
+#include "state.h"
+#include "trace.h"
+
+#include "timehead.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <ctype.h>
+
+	static	int	exit_flag = 0;
+	static	st_tree_t	*vars = NULL;
+	static	trace_out_t	out;
+	static	unsigned long	changes = 0;
+
+static void set_exit_flag(int sig)
+{
+	exit_flag = sig;
+}
+
+static void setup_signals(void)
+{
+	struct	sigaction	sa;
+
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+
+	sa.sa_handler = set_exit_flag;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGQUIT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+}
+
+static void help(const char *prog)
+{
+	printf("UPS variables recorder.\n");
+
+	printf("\nusage: %s [-i <interval>] <ups> <trace>\n", prog);
+	printf("       %s -s <socket> <trace>\n", prog);
+	printf("       %s -c <seqfile> <trace>\n", prog);
+	printf("       %s -d <trace>\n", prog);
+	printf("\n");
+
+	printf("  -i <interval>	- Time between polls of upsd, in seconds (default 1)\n");
+	printf("  -s <socket>	- Record from a driver socket instead of upsd\n");
+	printf("		- Example: -s dummy-ups-myups\n");
+	printf("  -c <seqfile>	- Compile a .seq file into a trace\n");
+	printf("  -d <trace>	- Dump a trace in the .seq format to stdout\n");
+	printf("  -D		- Raise debugging level\n");
+	printf("  -h		- Display this help text\n");
+	printf("\n");
+	printf("  <ups>		- <upsname>[@<host>[:<port>]]\n");
+	printf("  <trace>	- File to append to, or - for stdout\n");
+
+	exit(EXIT_SUCCESS);
+}
+
+static void record(int type, unsigned long long usec, const char *var,
+	const char *val)
+{
+	upsdebugx(2, "%s %s %s", (type == TRACE_SETINFO) ? "SETINFO" : "DELINFO",
+		var, val);
+
+	if (trace_write(&out, type, usec, var, val) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't write trace");
+	}
+
+	changes++;
+}
+
+/* store DELINFO for everything in old that isn't in cur anymore */
+static void record_gone(st_tree_t *node, st_tree_t *cur, unsigned long long usec)
+{
+	if (!node) {
+		return;
+	}
+
+	record_gone(node->left, cur, usec);
+
+	if (!state_getinfo(cur, node->var)) {
+		record(TRACE_DELINFO, usec, node->var, "");
+	}
+
+	record_gone(node->right, cur, usec);
+}
+
+/* returns -1 if the connection should be dropped */
+static int poll_upsd(UPSCONN_t *ups, const char *upsname)
+{
+	int	ret;
+	unsigned int	numq, numa;
+	const char	*query[2];
+	char	**answer;
+	st_tree_t	*cur = NULL;
+	unsigned long long	usec;
+
+	query[0] = "VAR";
+	query[1] = upsname;
+	numq = 2;
+
+	usec = monotime_usec();
+
+	ret = upscli_list_start(ups, numq, query);
+
+	if (ret < 0) {
+		upsdebugx(1, "LIST VAR %s: %s", upsname, upscli_strerror(ups));
+
+		/* keep the connection through DATA-STALE and friends */
+		if (upscli_fd(ups) < 0) {
+			return -1;
+		}
+
+		return 0;
+	}
+
+	while ((ret = upscli_list_next(ups, numq, query, &numa, &answer)) == 1) {
+
+		/* VAR <upsname> <varname> <val> */
+		if (numa < 4) {
+			continue;
+		}
+
+		state_setinfo(&cur, answer[2], answer[3]);
+
+		if (state_setinfo(&vars, answer[2], answer[3])) {
+			record(TRACE_SETINFO, usec, answer[2], answer[3]);
+		}
+	}
+
+	if (ret < 0) {
+		/* incomplete listing: don't take the missing ones as removed */
+		state_infofree(cur);
+		return -1;
+	}
+
+	record_gone(vars, cur, usec);
+
+	state_infofree(vars);
+	vars = cur;
+
+	return 0;
+}
+
+static void record_upsd(const char *monhost, double interval)
+{
+	int	port;
+	char	*upsname, *hostname;
+	UPSCONN_t	ups;
+	struct timeval	tv;
+	unsigned long long	next, usec;
+
+	if (upscli_splitname(monhost, &upsname, &hostname, &port) != 0) {
+		fatalx(EXIT_FAILURE, "Error: invalid UPS definition.  Required format: upsname[@hostname[:port]]");
+	}
+
+	if (upscli_connect(&ups, hostname, port, UPSCLI_CONN_TRYSSL) < 0) {
+		fatalx(EXIT_FAILURE, "Error: %s", upscli_strerror(&ups));
+	}
+
+	next = monotime_usec();
+
+	while (!exit_flag) {
+
+		/* reconnect if necessary */
+		if ((upscli_fd(&ups) >= 0) ||
+			(upscli_connect(&ups, hostname, port, UPSCLI_CONN_TRYSSL) == 0)) {
+
+			if (poll_upsd(&ups, upsname) < 0) {
+				upscli_disconnect(&ups);
+			}
+		}
+
+		if (trace_flush(&out) < 0) {
+			fatal_with_errno(EXIT_FAILURE, "Can't write trace");
+		}
+
+		next += interval * 1000000;
+		usec = monotime_usec();
+
+		/* usleep() may refuse a second or more */
+		if (next > usec) {
+			tv.tv_sec = (next - usec) / 1000000;
+			tv.tv_usec = (next - usec) % 1000000;
+			select(0, NULL, NULL, NULL, &tv);
+		} else {
+			/* polling takes longer than the interval */
+			next = usec;
+		}
+	}
+
+	upscli_disconnect(&ups);
+
+	free(upsname);
+	free(hostname);
+}
+
+static int sock_connect(const char *path)
+{
+	int	fd;
+	struct sockaddr_un	sa;
+	const char	*dumpcmd = "DUMPALL\n";
+
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		fatalx(EXIT_FAILURE, "Socket path %s is too long", path);
+	}
+
+	memset(&sa, '\0', sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	memcpy(sa.sun_path, path, strlen(path));
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't create socket");
+	}
+
+	if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+		upsdebug_with_errno(1, "Can't connect to %s", path);
+		close(fd);
+		return -1;
+	}
+
+	if (write(fd, dumpcmd, strlen(dumpcmd)) != (ssize_t)strlen(dumpcmd)) {
+		upsdebug_with_errno(1, "Can't send DUMPALL to %s", path);
+		close(fd);
+		return -1;
+	}
+
+	upsdebugx(1, "Connected to %s", path);
+
+	return fd;
+}
+
+static void sock_parse(PCONF_CTX_t *ctx, unsigned long long usec)
+{
+	if (ctx->numargs < 2) {
+		return;
+	}
+
+	if ((ctx->numargs >= 3) && !strcasecmp(ctx->arglist[0], "SETINFO")) {
+		if (state_setinfo(&vars, ctx->arglist[1], ctx->arglist[2])) {
+			record(TRACE_SETINFO, usec, ctx->arglist[1], ctx->arglist[2]);
+		}
+		return;
+	}
+
+	if (!strcasecmp(ctx->arglist[0], "DELINFO")) {
+		if (state_delinfo(&vars, ctx->arglist[1])) {
+			record(TRACE_DELINFO, usec, ctx->arglist[1], "");
+		}
+		return;
+	}
+
+	/* the rest (enums, ranges, commands, flags, ...) isn't recorded */
+}
+
+static void record_socket(const char *sockfn)
+{
+	int	fd = -1, ret;
+	ssize_t	i, len;
+	char	path[SMALLBUF], buf[SMALLBUF];
+	PCONF_CTX_t	ctx;
+	fd_set	rfds;
+	struct timeval	tv;
+	unsigned long long	usec, flushed = 0;
+
+	if (strchr(sockfn, '/')) {
+		snprintf(path, sizeof(path), "%s", sockfn);
+	} else {
+		snprintf(path, sizeof(path), "%s/%s", dflt_statepath(), sockfn);
+	}
+
+	while (!exit_flag) {
+
+		if (fd < 0) {
+			fd = sock_connect(path);
+
+			if (fd < 0) {
+				sleep(1);
+				continue;
+			}
+
+			pconf_init(&ctx, NULL);
+		}
+
+		FD_ZERO(&rfds);
+		FD_SET(fd, &rfds);
+
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+
+		ret = select(fd + 1, &rfds, NULL, NULL, &tv);
+
+		usec = monotime_usec();
+
+		if (ret > 0) {
+			len = read(fd, buf, sizeof(buf));
+
+			if (len <= 0) {
+				upsdebugx(1, "Lost connection to %s", path);
+				pconf_finish(&ctx);
+				close(fd);
+				fd = -1;
+				continue;
+			}
+
+			for (i = 0; i < len; i++) {
+				if (pconf_char(&ctx, buf[i]) == 1) {
+					sock_parse(&ctx, usec);
+				}
+			}
+		}
+
+		/* batch the writes when the driver is busy */
+		if ((ret == 0) || (usec - flushed >= 1000000)) {
+			if (trace_flush(&out) < 0) {
+				fatal_with_errno(EXIT_FAILURE, "Can't write trace");
+			}
+
+			flushed = usec;
+		}
+	}
+
+	if (fd >= 0) {
+		pconf_finish(&ctx);
+		close(fd);
+	}
+}
+
+static void seq_err(const char *errmsg)
+{
+	upslogx(LOG_ERR, "Fatal error in parseconf: %s", errmsg);
+}
+
+/* same parsing rules as dummy-ups */
+static void compile_seq(const char *seqfn)
+{
+	size_t	i;
+	char	*ptr, val[ST_MAX_VALUE_LEN];
+	unsigned long long	usec = 0, last = 0;
+	PCONF_CTX_t	ctx;
+
+	pconf_init(&ctx, seq_err);
+
+	if (!pconf_file_begin(&ctx, seqfn)) {
+		fatalx(EXIT_FAILURE, "Can't open %s: %s", seqfn, ctx.errmsg);
+	}
+
+	while (pconf_file_next(&ctx)) {
+
+		if (pconf_parse_error(&ctx)) {
+			upslogx(LOG_ERR, "Parse error: %s:%d: %s",
+				seqfn, ctx.linenum, ctx.errmsg);
+			continue;
+		}
+
+		if (ctx.numargs < 1) {
+			continue;
+		}
+
+		if (!strncmp(ctx.arglist[0], "TIMER", 5)) {
+			if (ctx.numargs > 1) {
+				usec += atoi(ctx.arglist[1]) * 1000000ULL;
+			}
+			continue;
+		}
+
+		if ((ptr = strchr(ctx.arglist[0], ':')) != NULL) {
+			*ptr = '\0';
+		}
+
+		val[0] = '\0';
+
+		for (i = 1; i < ctx.numargs; i++) {
+			snprintfcat(val, sizeof(val), "%s%s", (i > 1) ? " " : "",
+				ctx.arglist[i]);
+		}
+
+		record(TRACE_SETINFO, usec, ctx.arglist[0], val);
+		last = usec;
+	}
+
+	/* keep a final TIMER, so that looping preserves the timing */
+	if ((usec > last) && (trace_write(&out, TRACE_WAIT, usec, NULL, NULL) < 0)) {
+		fatal_with_errno(EXIT_FAILURE, "Can't write trace");
+	}
+
+	pconf_finish(&ctx);
+}
+
+static void dump_seq(const char *tracefn)
+{
+	int	ret;
+	size_t	len;
+	char	enc[ST_MAX_VALUE_LEN * 2];
+	unsigned long long	shown = 0;
+	trace_t	trace;
+	trace_rec_t	rec;
+
+	if (trace_open(&trace, tracefn) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't open trace %s", tracefn);
+	}
+
+	printf("# dummy-ups sequence converted from %s\n\n", tracefn);
+
+	while ((ret = trace_next(&trace, &rec)) == 1) {
+
+		/* .seq only has whole seconds, carry the rest over */
+		if (rec.usec - shown >= 1000000) {
+			unsigned long long	sec = (rec.usec - shown) / 1000000;
+
+			printf("TIMER %llu\n", sec);
+			shown += sec * 1000000;
+		}
+
+		switch (rec.type)
+		{
+		case TRACE_SETINFO:
+			len = strlen(rec.val);
+
+			/* quote what the parser wouldn't read back as is */
+			if ((len == 0) || isspace((unsigned char)rec.val[0]) ||
+				isspace((unsigned char)rec.val[len - 1]) ||
+				strpbrk(rec.val, "\"\\#")) {
+				printf("%s: \"%s\"\n", rec.var,
+					pconf_encode(rec.val, enc, sizeof(enc)));
+			} else {
+				printf("%s: %s\n", rec.var, rec.val);
+			}
+			break;
+
+		case TRACE_DELINFO:
+			/* .seq can't remove variables */
+			printf("# DELINFO %s\n", rec.var);
+			break;
+		}
+	}
+
+	if (ret < 0) {
+		upslogx(LOG_WARNING, "Trace %s is truncated", tracefn);
+	}
+
+	trace_close(&trace);
+}
+
+int main(int argc, char **argv)
+{
+	int	i;
+	double	interval = 1;
+	const char	*prog = xbasename(argv[0]);
+	const char	*sockfn = NULL, *seqfn = NULL, *dumpfn = NULL;
+
+	while ((i = getopt(argc, argv, "+hi:s:c:d:DV")) != -1) {
+		switch (i)
+		{
+		case 'i':
+			interval = strtod(optarg, NULL);
+			break;
+
+		case 's':
+			sockfn = optarg;
+			break;
+
+		case 'c':
+			seqfn = optarg;
+			break;
+
+		case 'd':
+			dumpfn = optarg;
+			break;
+
+		case 'D':
+			nut_debug_level++;
+			break;
+
+		case 'V':
+			printf("Network UPS Tools %s %s\n", prog, UPS_VERSION);
+			exit(EXIT_SUCCESS);
+
+		case 'h':
+		default:
+			help(prog);
+			break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (dumpfn) {
+		dump_seq(dumpfn);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (argc != ((sockfn || seqfn) ? 1 : 2)) {
+		help(prog);
+	}
+
+	if (interval <= 0) {
+		fatalx(EXIT_FAILURE, "Error: invalid interval");
+	}
+
+	if (trace_create(&out, argv[argc - 1]) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't open trace %s", argv[argc - 1]);
+	}
+
+	if (seqfn) {
+		compile_seq(seqfn);
+	} else {
+		setup_signals();
+
+		if (sockfn) {
+			record_socket(sockfn);
+		} else {
+			record_upsd(argv[0], interval);
+		}
+
+		upsdebugx(1, "Signal %d: exiting", exit_flag);
+	}
+
+	if (trace_finish(&out) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't write trace");
+	}
+
+	upsdebugx(1, "%lu changes recorded", changes);
+
+	state_infofree(vars);
+
+	exit(EXIT_SUCCESS);
+}
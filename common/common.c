@@ -24,6 +24,10 @@
 #include <pwd.h>
 #include <grp.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 /* the reason we define UPS_VERSION as a static string, rather than a
 	macro, is to make dependency tracking easier (only common.o depends
 	on nut_version_macro.h), and also to prevent all sources from
@@ -314,21 +318,404 @@ const char *xbasename(const char *file)
 	return p + 1;
 }
 
-static void vupslog(int priority, const char *fmt, va_list va, int use_strerror)
+/* Asynchronous logging: once a daemon calls upslog_async(), the messages
+ * are queued to a ring buffer, and written to stderr and the syslog by a
+ * background thread.  The caller never waits for the output, except when
+ * the ring is full: debug messages are then dropped (and counted), others
+ * are written right away after what is queued.  Each debug call site, told
+ * apart by its format string, is also limited to UPSLOG_RATELIMIT messages
+ * per second, and how many were suppressed is told once it goes quiet.
+ * Everything still queued is written at exit.
+ */
+
+#define UPSLOG_RING_SIZE	65536
+#define UPSLOG_RATELIMIT	100	/* debug messages per second and call site */
+#define UPSLOG_RATE_SITES	256	/* power of 2 */
+#define UPSLOG_RATE_PROBE	4	/* slots tried for a call site */
+
+typedef struct {
+	int	priority;
+	int	flags;		/* upslog_flags when queued */
+	size_t	len;		/* of the text, timestamp included */
+	size_t	msgofs;		/* message after the timestamp */
+} logrec_t;
+
+typedef struct {
+	const char	*fmt;
+	time_t	second;
+	unsigned int	count;
+	unsigned long	suppressed;
+} logsite_t;
+
+#ifdef HAVE_PTHREAD
+static struct {
+	int	active;
+	pthread_t	thread;
+	char	ring[UPSLOG_RING_SIZE];
+	size_t	head, tail;		/* free running, head - tail is in use */
+	unsigned long	dropped;
+	logsite_t	sites[UPSLOG_RATE_SITES];
+	unsigned int	limited;	/* sites with suppressed messages */
+} logq;
+
+static	pthread_mutex_t	log_lock = PTHREAD_MUTEX_INITIALIZER;	/* logq */
+static	pthread_mutex_t	log_outlock = PTHREAD_MUTEX_INITIALIZER;	/* output order */
+static	pthread_cond_t	log_cond = PTHREAD_COND_INITIALIZER;
+
+static void ring_copy(int put, size_t pos, void *data, size_t len)
 {
-	int	ret;
-	char	buf[LARGEBUF];
+	size_t	ofs = pos % UPSLOG_RING_SIZE, n;
 
-	ret = vsnprintf(buf, sizeof(buf), fmt, va);
+	n = UPSLOG_RING_SIZE - ofs;
 
-	if ((ret < 0) || (ret >= (int) sizeof(buf)))
-		syslog(LOG_WARNING, "vupslog: vsnprintf needed more than %d bytes",
-			LARGEBUF);
+	if (n > len)
+		n = len;
 
-	if (use_strerror)
-		snprintfcat(buf, sizeof(buf), ": %s", strerror(errno));
+	if (put) {
+		memcpy(&logq.ring[ofs], data, n);
+		memcpy(logq.ring, (char *)data + n, len - n);
+	} else {
+		memcpy(data, &logq.ring[ofs], n);
+		memcpy((char *)data + n, logq.ring, len - n);
+	}
+}
+#endif
+
+static void log_write(const logrec_t *rec, const char *text)
+{
+	if (xbit_test(rec->flags, UPSLOG_STDERR))
+		fprintf(stderr, "%s\n", text);
+	if (xbit_test(rec->flags, UPSLOG_SYSLOG))
+		syslog(rec->priority, "%s", &text[rec->msgofs]);
+}
+
+#ifdef HAVE_PTHREAD
+/* frees a call site slot, returns how many messages it suppressed */
+static unsigned long site_release(logsite_t *site, const char **fmt)
+{
+	unsigned long	suppressed = site->suppressed;
+
+	if (suppressed)
+		logq.limited--;
+
+	*fmt = site->fmt;
+
+	site->fmt = NULL;
+	site->count = 0;
+	site->suppressed = 0;
+
+	return suppressed;
+}
+
+/* report the limited call sites that went quiet, or all of them */
+static void log_report_sites(int all)
+{
+	logrec_t	rec;
+	logsite_t	*site;
+	char	text[LARGEBUF];
+	const char	*fmt;
+	unsigned long	suppressed;
+	time_t	now;
+	int	i;
+
+	time(&now);
+
+	for (i = 0; i < UPSLOG_RATE_SITES; i++) {
+		pthread_mutex_lock(&log_lock);
+
+		if (!logq.limited) {
+			pthread_mutex_unlock(&log_lock);
+			break;
+		}
+
+		site = &logq.sites[i];
+		suppressed = 0;
+
+		if (site->suppressed && (all || (site->second != now)))
+			suppressed = site_release(site, &fmt);
+
+		pthread_mutex_unlock(&log_lock);
+
+		if (!suppressed)
+			continue;
+
+		rec.priority = LOG_DEBUG;
+		rec.flags = upslog_flags;
+		rec.msgofs = 0;
+		snprintf(text, sizeof(text),
+			"Rate limit: %lu messages suppressed like [%s]",
+			suppressed, fmt);
+		log_write(&rec, text);
+	}
+}
+
+/* write out what is queued, returns 0 if there was nothing */
+static int log_drain(void)
+{
+	logrec_t	rec;
+	char	text[LARGEBUF + SMALLBUF];
+	unsigned long	dropped;
+	int	done = 0;
+
+	pthread_mutex_lock(&log_outlock);
+
+	for (;;) {
+		pthread_mutex_lock(&log_lock);
+
+		dropped = logq.dropped;
+		logq.dropped = 0;
+
+		if (logq.head == logq.tail) {
+			pthread_mutex_unlock(&log_lock);
+			break;
+		}
+
+		ring_copy(0, logq.tail, &rec, sizeof(rec));
+		ring_copy(0, logq.tail + sizeof(rec), text, rec.len);
+		logq.tail += sizeof(rec) + rec.len;
+
+		pthread_mutex_unlock(&log_lock);
+
+		text[rec.len] = '\0';
+		log_write(&rec, text);
+		done = 1;
+
+		if (dropped) {
+			rec.priority = LOG_WARNING;
+			snprintf(text, sizeof(text),
+				"Logging too fast: %lu messages dropped", dropped);
+			rec.msgofs = 0;
+			log_write(&rec, text);
+		}
+	}
+
+	log_report_sites(0);
+
+	pthread_mutex_unlock(&log_outlock);
+
+	return done;
+}
+
+static void *log_thread(void *arg)
+{
+	struct timespec	ts;
+
+	for (;;) {
+		pthread_mutex_lock(&log_lock);
+
+		while (logq.head == logq.tail) {
+			if (!logq.limited) {
+				pthread_cond_wait(&log_cond, &log_lock);
+				continue;
+			}
+
+			/* wake up next second to report the limited sites */
+			ts.tv_sec = time(NULL) + 1;
+			ts.tv_nsec = 0;
+
+			if (pthread_cond_timedwait(&log_cond, &log_lock, &ts) == ETIMEDOUT)
+				break;
+		}
+
+		pthread_mutex_unlock(&log_lock);
+
+		log_drain();
+	}
+
+	return NULL;
+}
+
+/* returns 0 if the message wasn't queued, and the caller has to write it */
+static int log_queue(const logrec_t *rec, const char *text)
+{
+	logrec_t	tmp = *rec;
+	int	was_empty;
+
+	pthread_mutex_lock(&log_lock);
+
+	/* raced with log_atexit() */
+	if (!logq.active) {
+		pthread_mutex_unlock(&log_lock);
+		return 0;
+	}
+
+	if (UPSLOG_RING_SIZE - (logq.head - logq.tail) < sizeof(tmp) + tmp.len) {
+
+		if (tmp.priority == LOG_DEBUG) {
+			logq.dropped++;
+			pthread_mutex_unlock(&log_lock);
+			return 1;
+		}
+
+		/* too important to lose: keep the order and do it ourselves */
+		pthread_mutex_unlock(&log_lock);
+		log_drain();
+		return 0;
+	}
+
+	was_empty = (logq.head == logq.tail);
+
+	ring_copy(1, logq.head, &tmp, sizeof(tmp));
+	ring_copy(1, logq.head + sizeof(tmp), (void *)text, tmp.len);
+	logq.head += sizeof(tmp) + tmp.len;
+
+	/* the thread only sleeps on an empty ring */
+	if (was_empty)
+		pthread_cond_signal(&log_cond);
+
+	pthread_mutex_unlock(&log_lock);
+
+	return 1;
+}
+
+/* the cleanup code that runs after us logs synchronously */
+static void log_atexit(void)
+{
+	if (!logq.active)
+		return;
+
+	log_drain();
+
+	pthread_mutex_lock(&log_lock);
+	logq.active = 0;
+	pthread_mutex_unlock(&log_lock);
+
+	/* anything queued meanwhile */
+	log_drain();
+
+	pthread_mutex_lock(&log_outlock);
+	log_report_sites(1);
+	pthread_mutex_unlock(&log_outlock);
+}
 
-	if (nut_debug_level > 0) {
+static void log_prefork(void)
+{
+	pthread_mutex_lock(&log_outlock);
+	pthread_mutex_lock(&log_lock);
+}
+
+static void log_postfork_parent(void)
+{
+	pthread_mutex_unlock(&log_lock);
+	pthread_mutex_unlock(&log_outlock);
+}
+
+/* the thread isn't there anymore, and the parent writes what is queued */
+static void log_postfork_child(void)
+{
+	logq.active = 0;
+	logq.head = logq.tail = 0;
+	logq.dropped = 0;
+
+	pthread_mutex_unlock(&log_lock);
+	pthread_mutex_unlock(&log_outlock);
+}
+
+/* returns 0 if this debug message should be skipped */
+static int log_ratelimit(const char *fmt)
+{
+	logsite_t	*site = NULL, *tmp;
+	const char	*oldfmt = NULL;
+	unsigned long	suppressed = 0;
+	size_t	slot = (size_t)fmt >> 3;
+	time_t	now;
+	int	i;
+
+	if (!logq.active)
+		return 1;
+
+	time(&now);
+
+	pthread_mutex_lock(&log_lock);
+
+	/* our own slot, or else a free one, or one idle since last second */
+	for (i = 0; i < UPSLOG_RATE_PROBE; i++) {
+		tmp = &logq.sites[(slot + i) & (UPSLOG_RATE_SITES - 1)];
+
+		if (tmp->fmt == fmt) {
+			site = tmp;
+			break;
+		}
+
+		if (!site && (!tmp->fmt || (tmp->second != now)))
+			site = tmp;
+	}
+
+	/* too many busy sites around: don't take their counts over */
+	if (!site) {
+		pthread_mutex_unlock(&log_lock);
+		return 1;
+	}
+
+	if ((site->fmt != fmt) || (site->second != now)) {
+		suppressed = site_release(site, &oldfmt);
+		site->fmt = fmt;
+		site->second = now;
+	}
+
+	if (site->count >= UPSLOG_RATELIMIT) {
+		/* the thread may have to wake up to report it */
+		if ((site->suppressed++ == 0) && (logq.limited++ == 0))
+			pthread_cond_signal(&log_cond);
+
+		pthread_mutex_unlock(&log_lock);
+		return 0;
+	}
+
+	site->count++;
+
+	pthread_mutex_unlock(&log_lock);
+
+	if (suppressed)
+		upslogx(LOG_DEBUG, "Rate limit: %lu messages suppressed like [%s]",
+			suppressed, oldfmt);
+
+	return 1;
+}
+#else
+static int log_ratelimit(const char *fmt)
+{
+	return 1;
+}
+#endif	/* HAVE_PTHREAD */
+
+/* queue the messages to a background thread from now on (once forked) */
+void upslog_async(void)
+{
+#ifdef HAVE_PTHREAD
+	static	int	registered = 0;
+
+	if (logq.active)
+		return;
+
+	if (!registered) {
+		pthread_atfork(log_prefork, log_postfork_parent, log_postfork_child);
+		atexit(log_atexit);
+		registered = 1;
+	}
+
+	if (pthread_create(&logq.thread, NULL, log_thread, NULL) != 0) {
+		upslog_with_errno(LOG_WARNING, "Can't start the logging thread");
+		return;
+	}
+
+	pthread_detach(logq.thread);
+	logq.active = 1;
+#endif
+}
+
+static void vupslog(int priority, const char *fmt, va_list va, int use_strerror)
+{
+	int	ret;
+	char	buf[LARGEBUF + SMALLBUF];
+	logrec_t	rec;
+
+	rec.priority = priority;
+	rec.flags = upslog_flags;
+	rec.msgofs = 0;
+
+	/* the timestamp only goes to stderr */
+	if ((nut_debug_level > 0) && xbit_test(upslog_flags, UPSLOG_STDERR)) {
 		static struct timeval	start = { 0 };
 		struct timeval		now;
 	
@@ -343,13 +730,32 @@ static void vupslog(int priority, const char *fmt, va_list va, int use_strerror)
 			now.tv_sec -= 1;
 		}
 	
-		fprintf(stderr, "%4.0f.%06ld\t", difftime(now.tv_sec, start.tv_sec), (long)(now.tv_usec - start.tv_usec));
+		rec.msgofs = snprintf(buf, sizeof(buf), "%4.0f.%06ld\t",
+			difftime(now.tv_sec, start.tv_sec), (long)(now.tv_usec - start.tv_usec));
 	}
 
-	if (xbit_test(upslog_flags, UPSLOG_STDERR))
-		fprintf(stderr, "%s\n", buf);
-	if (xbit_test(upslog_flags, UPSLOG_SYSLOG))
-		syslog(priority, "%s", buf);
+	ret = vsnprintf(&buf[rec.msgofs], LARGEBUF, fmt, va);
+
+	if ((ret < 0) || (ret >= LARGEBUF))
+		syslog(LOG_WARNING, "vupslog: vsnprintf needed more than %d bytes",
+			LARGEBUF);
+
+	if (use_strerror)
+		snprintfcat(buf, sizeof(buf), ": %s", strerror(errno));
+
+	rec.len = strlen(buf);
+
+#ifdef HAVE_PTHREAD
+	if (logq.active && log_queue(&rec, buf))
+		return;
+
+	/* don't mix with what the thread may be writing */
+	pthread_mutex_lock(&log_outlock);
+	log_write(&rec, buf);
+	pthread_mutex_unlock(&log_outlock);
+#else
+	log_write(&rec, buf);
+#endif
 }
 
 /* Return the default path for the directory containing configuration files */
@@ -384,6 +790,28 @@ const char * altpidpath(void)
 #endif
 }
 
+unsigned long long monotime_usec(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec	ts;
+#endif
+	struct timeval	tv;
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+#endif
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+double monotime(void)
+{
+	return monotime_usec() / 1e6;
+}
+
 /* logs the formatted string to any configured logging devices + the output of strerror(errno) */
 void upslog_with_errno(int priority, const char *fmt, ...)
 {
@@ -411,6 +839,9 @@ void upsdebug_with_errno(int level, const char *fmt, ...)
 	if (nut_debug_level < level)
 		return;
 
+	if (!log_ratelimit(fmt))
+		return;
+
 	va_start(va, fmt);
 	vupslog(LOG_DEBUG, fmt, va, 1);
 	va_end(va);
@@ -423,6 +854,9 @@ void upsdebugx(int level, const char *fmt, ...)
 	if (nut_debug_level < level)
 		return;
 
+	if (!log_ratelimit(fmt))
+		return;
+
 	va_start(va, fmt);
 	vupslog(LOG_DEBUG, fmt, va, 0);
 	va_end(va);
@@ -437,19 +871,26 @@ void upsdebug_hex(int level, const char *msg, const void *buf, int len)
 	int n;	/* number of characters currently in line */
 	int i;	/* number of bytes output from buffer */
 
+	if (nut_debug_level < level)
+		return;
+
+	/* the call site is told apart by msg, and a dump is never cut short */
+	if (!log_ratelimit(msg))
+		return;
+
 	n = snprintf(line, sizeof(line), "%s: (%d bytes) =>", msg, len); 
 
 	for (i = 0; i < len; i++) {
 
 		if (n > 72) {
-			upsdebugx(level, "%s", line);
+			upslogx(LOG_DEBUG, "%s", line);
 			line[0] = 0;
 		}
 
 		n = snprintfcat(line, sizeof(line), n ? " %02x" : "%02x",
 			((unsigned char *)buf)[i]);
 	}
-	upsdebugx(level, "%s", line);
+	upslogx(LOG_DEBUG, "%s", line);
 }
 
 static void vfatal(const char *fmt, va_list va, int use_strerror)
@@ -0,0 +1,415 @@
+/* trace.c - compact binary traces of device variables
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "common.h"
+#include "trace.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+static unsigned long get_le(const unsigned char *buf, int len)
+{
+	unsigned long	val = 0;
+
+	while (len-- > 0) {
+		val = (val << 8) | buf[len];
+	}
+
+	return val;
+}
+
+static void put_le(unsigned char *buf, unsigned long val, int len)
+{
+	int	i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = val & 0xff;
+		val >>= 8;
+	}
+}
+
+int trace_open(trace_t *trace, const char *fn)
+{
+	struct stat	st;
+	unsigned char	*buf;
+	int	fd, err;
+
+	memset(trace, 0, sizeof(*trace));
+
+	fd = open(fn, O_RDONLY);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+
+	if (st.st_size < TRACE_HDR_LEN) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	trace->size = st.st_size;
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+	buf = mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (buf != MAP_FAILED) {
+		trace->mapped = 1;
+	} else
+#endif
+	{
+		ssize_t	ret;
+		size_t	len;
+
+		buf = xmalloc(trace->size);
+
+		for (len = 0; len < trace->size; len += ret) {
+			ret = read(fd, &buf[len], trace->size - len);
+
+			if (ret <= 0) {
+				err = (ret < 0) ? errno : EINVAL;
+				free(buf);
+				close(fd);
+				errno = err;
+				return -1;
+			}
+		}
+	}
+
+	close(fd);
+
+	trace->data = buf;
+
+	if (memcmp(buf, TRACE_MAGIC, strlen(TRACE_MAGIC)) ||
+		(get_le(&buf[8], 4) != TRACE_VERSION)) {
+		trace_close(trace);
+		errno = EINVAL;
+		return -1;
+	}
+
+	trace_rewind(trace);
+
+	return 0;
+}
+
+int trace_next(trace_t *trace, trace_rec_t *rec)
+{
+	const unsigned char	*p;
+	size_t	namelen, vallen;
+
+	if (trace->pos == trace->size) {
+		return 0;
+	}
+
+	if (trace->pos + TRACE_REC_LEN > trace->size) {
+		return -1;
+	}
+
+	p = &trace->data[trace->pos];
+
+	rec->type = p[0];
+	namelen = p[1];
+	vallen = get_le(&p[2], 2);
+
+	if (trace->pos + TRACE_REC_LEN + namelen + vallen > trace->size) {
+		return -1;
+	}
+
+	trace->usec += get_le(&p[4], 4);
+	trace->pos += TRACE_REC_LEN + namelen + vallen;
+
+	rec->usec = trace->usec;
+
+	p += TRACE_REC_LEN;
+
+	/* the names are shorter than SMALLBUF, but values may be truncated */
+	memcpy(rec->var, p, namelen);
+	rec->var[namelen] = '\0';
+
+	p += namelen;
+
+	if (vallen >= sizeof(rec->val)) {
+		vallen = sizeof(rec->val) - 1;
+	}
+
+	memcpy(rec->val, p, vallen);
+	rec->val[vallen] = '\0';
+
+	return 1;
+}
+
+void trace_rewind(trace_t *trace)
+{
+	trace->pos = TRACE_HDR_LEN;
+	trace->usec = 0;
+}
+
+void trace_close(trace_t *trace)
+{
+	if (!trace->data) {
+		return;
+	}
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+	if (trace->mapped) {
+		munmap((void *)trace->data, trace->size);
+	} else
+#endif
+	{
+		free((void *)trace->data);
+	}
+
+	memset(trace, 0, sizeof(*trace));
+}
+
+static int write_all(int fd, const unsigned char *buf, size_t len)
+{
+	ssize_t	ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int put_buf(trace_out_t *out, const void *data, size_t len)
+{
+	const unsigned char	*p = data;
+	size_t	n;
+
+	while (len > 0) {
+
+		if (out->len == sizeof(out->buf)) {
+			if (trace_flush(out) < 0) {
+				return -1;
+			}
+		}
+
+		n = sizeof(out->buf) - out->len;
+
+		if (n > len) {
+			n = len;
+		}
+
+		memcpy(&out->buf[out->len], p, n);
+		out->len += n;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int put_rec(trace_out_t *out, int type, unsigned long delta,
+	const char *var, size_t namelen, const char *val, size_t vallen)
+{
+	unsigned char	hdr[TRACE_REC_LEN];
+
+	hdr[0] = type;
+	hdr[1] = namelen;
+	put_le(&hdr[2], vallen, 2);
+	put_le(&hdr[4], delta, 4);
+
+	if ((put_buf(out, hdr, sizeof(hdr)) < 0) ||
+		(put_buf(out, var, namelen) < 0) ||
+		(put_buf(out, val, vallen) < 0)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* end of the last complete record, a recording may have been cut short */
+static off_t trace_end(int fd, off_t size)
+{
+	unsigned char	rec[TRACE_REC_LEN];
+	off_t	pos, next;
+
+	for (pos = TRACE_HDR_LEN; pos + TRACE_REC_LEN <= size; pos = next) {
+
+		if (lseek(fd, pos, SEEK_SET) < 0) {
+			return -1;
+		}
+
+		if (read(fd, rec, sizeof(rec)) != sizeof(rec)) {
+			errno = EIO;
+			return -1;
+		}
+
+		next = pos + TRACE_REC_LEN + rec[1] + get_le(&rec[2], 2);
+
+		if (next > size) {
+			break;
+		}
+	}
+
+	return pos;
+}
+
+int trace_create(trace_out_t *out, const char *fn)
+{
+	struct stat	st;
+	unsigned char	hdr[TRACE_HDR_LEN];
+	off_t	end;
+	int	err;
+
+	memset(out, 0, sizeof(*out));
+
+	if (!strcmp(fn, "-")) {
+		out->fd = STDOUT_FILENO;
+	} else {
+		out->fd = open(fn, O_RDWR | O_CREAT | O_APPEND, 0644);
+	}
+
+	if (out->fd < 0) {
+		return -1;
+	}
+
+	if (fstat(out->fd, &st) < 0) {
+		goto fail;
+	}
+
+	/* appending to an existing trace */
+	if (S_ISREG(st.st_mode) && (st.st_size > 0)) {
+
+		if ((st.st_size < TRACE_HDR_LEN) ||
+			(read(out->fd, hdr, sizeof(hdr)) != sizeof(hdr)) ||
+			memcmp(hdr, TRACE_MAGIC, strlen(TRACE_MAGIC)) ||
+			(get_le(&hdr[8], 4) != TRACE_VERSION)) {
+			errno = EINVAL;
+			goto fail;
+		}
+
+		/* the records must follow the last one that is whole */
+		end = trace_end(out->fd, st.st_size);
+
+		if ((end < 0) ||
+			((end < st.st_size) && (ftruncate(out->fd, end) < 0))) {
+			goto fail;
+		}
+
+		return 0;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, TRACE_MAGIC, strlen(TRACE_MAGIC));
+	put_le(&hdr[8], TRACE_VERSION, 4);
+
+	if (write_all(out->fd, hdr, sizeof(hdr)) < 0) {
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	err = errno;
+
+	if (out->fd != STDOUT_FILENO) {
+		close(out->fd);
+	}
+
+	out->fd = -1;
+	errno = err;
+
+	return -1;
+}
+
+int trace_write(trace_out_t *out, int type, unsigned long long usec,
+	const char *var, const char *val)
+{
+	unsigned long long	delta;
+	size_t	namelen, vallen;
+
+	if (!out->started || (usec < out->usec)) {
+		out->usec = usec;
+		out->started = 1;
+	}
+
+	delta = usec - out->usec;
+	out->usec = usec;
+
+	/* split pauses that don't fit in a record */
+	while (delta > 0xffffffffUL) {
+		if (put_rec(out, TRACE_WAIT, 0xffffffffUL, "", 0, "", 0) < 0) {
+			return -1;
+		}
+
+		delta -= 0xffffffffUL;
+	}
+
+	if (type == TRACE_WAIT) {
+		return put_rec(out, TRACE_WAIT, delta, "", 0, "", 0);
+	}
+
+	namelen = strlen(var);
+	vallen = (type == TRACE_SETINFO) ? strlen(val) : 0;
+
+	/* the readers truncate longer values anyway */
+	if (namelen > 0xff) {
+		namelen = 0xff;
+	}
+
+	if (vallen >= ST_MAX_VALUE_LEN) {
+		vallen = ST_MAX_VALUE_LEN - 1;
+	}
+
+	return put_rec(out, type, delta, var, namelen, val, vallen);
+}
+
+int trace_flush(trace_out_t *out)
+{
+	size_t	len = out->len;
+
+	out->len = 0;
+
+	return write_all(out->fd, out->buf, len);
+}
+
+int trace_finish(trace_out_t *out)
+{
+	int	ret;
+
+	ret = trace_flush(out);
+
+	if ((out->fd != STDOUT_FILENO) && (close(out->fd) < 0)) {
+		ret = -1;
+	}
+
+	out->fd = -1;
+
+	return ret;
+}
@@ -45,6 +45,11 @@ upsdrv_info_t upsdrv_info = {
 
 static int ups_status = 0;
 
+/* scheduled polling state */
+static int sched_mode = 0;
+static int sched_next = 0;	/* next slow variable to poll */
+static int sched_flushing = 0;
+
 /*
  * Aix compatible names
  */
@@ -1765,6 +1770,146 @@ static void update_info_all(void)
 	upsdebugx(3, "update_info_all: done");
 }
 
+/*
+ * scheduled polling - the queries are queued to the serial transport, and the
+ * replies processed from the main loop, along with the alerts
+ */
+static void sched_failed(const char *what, int ret)
+{
+	/* the other queued queries are dropped below */
+	if (sched_flushing)
+		return;
+
+	ser_comm_fail("%s: %s", what, ret ? "read failed" : "timeout");
+	dstate_datastale();
+
+	/* abort the scan, like update_info_normal() */
+	upsdebugx(3, "%s failed - aborting scan", what);
+	sched_flushing = 1;
+	ser_async_flush();
+	sched_flushing = 0;
+}
+
+static void sched_reply_status(int ret, const char *buf, void *arg)
+{
+	if (ret < 1) {
+		sched_failed("status", ret);
+		return;
+	}
+
+	ser_comm_good();
+
+	if (!strcmp(buf, "NA")) {
+		dstate_datastale();
+		return;
+	}
+
+	ups_status = strtol(buf, 0, 16) & 0xff;
+	ups_status_set();
+
+	dstate_dataok();
+}
+
+static void sched_reply_var(int ret, const char *buf, void *arg)
+{
+	apc_vartab_t	*vt = arg;
+
+	if (ret < 1) {
+		sched_failed(vt->name, ret);
+		return;
+	}
+
+	ser_comm_good();
+
+	/* automagically no longer supported by the hardware somehow */
+	if (!strcmp(buf, "NA")) {
+		remove_var("sched_reply_var", vt);
+		return;
+	}
+
+	dstate_setinfo(vt->name, "%s", convert_data(vt, buf));
+	dstate_dataok();
+}
+
+static void sched_query(char cmd, void (*reply)(int, const char *, void *), void *arg)
+{
+	ser_request_t	req;
+
+	memset(&req, 0, sizeof(req));
+
+	req.cmd = &cmd;
+	req.cmdlen = 1;
+	req.endchar = ENDCHAR;
+	req.ignset = IGN_AACHARS "*";
+	req.reply = reply;
+	req.arg = arg;
+	req.d_sec = 3;
+
+	ser_async_queue(&req);
+}
+
+static void update_info_sched(int full)
+{
+	int	i, n, count, slow = 0;
+
+	/* the previous scan is still running on a slow link */
+	if (ser_async_pending()) {
+		upsdebugx(3, "update_info_sched: %d queries pending", ser_async_pending());
+		return;
+	}
+
+	upsdebugx(3, "update_info_sched: queueing %s scan", full ? "full" : "normal");
+
+	sched_query(APC_STATUS, sched_reply_status, NULL);
+
+	for (count = 0; apc_vartab[count].name != NULL; count++) {
+		if (!(apc_vartab[count].flags & APC_PRESENT))
+			continue;
+
+		if (full || (apc_vartab[count].flags & APC_FAST)) {
+			sched_query(apc_vartab[count].cmd, sched_reply_var, &apc_vartab[count]);
+			continue;
+		}
+
+		if (apc_vartab[count].flags & APC_POLL)
+			slow++;
+	}
+
+	if (full || !slow)
+		return;
+
+	/* the slow variables share the remaining link time */
+	slow = (slow + SCHED_SLOW_CYCLES - 1) / SCHED_SLOW_CYCLES;
+
+	for (n = 0; (n < count) && (slow > 0); n++) {
+		i = (sched_next + n) % count;
+
+		if ((apc_vartab[i].flags & (APC_PRESENT|APC_POLL|APC_FAST)) != (APC_PRESENT|APC_POLL))
+			continue;
+
+		sched_query(apc_vartab[i].cmd, sched_reply_var, &apc_vartab[i]);
+		slow--;
+	}
+
+	sched_next = (sched_next + n) % count;
+}
+
+/* stop the scheduled polling before talking to the UPS directly */
+static void sched_stop(void)
+{
+	char	temp[APC_LBUF];
+
+	if (!sched_mode || !ser_async_pending())
+		return;
+
+	sched_flushing = 1;
+	ser_async_flush();
+	sched_flushing = 0;
+
+	/* the reply to a query already sent may still come */
+	apc_read(temp, sizeof(temp), SER_DX|SER_TO|SER_AA);
+}
+
 static int setvar_enum(apc_vartab_t *vt, const char *val)
 {
 	int	i, ret;
@@ -1934,6 +2079,8 @@ static int setvar(const char *varname, const char *val)
 {
 	apc_vartab_t	*vt;
 
+	sched_stop();
+
 	vt = vartab_lookup_name(varname);
 
 	if (!vt)
@@ -2042,6 +2189,8 @@ static int instcmd(const char *cmd, const char *ext)
 	int i;
 	apc_cmdtab_t *ct = NULL;
 
+	sched_stop();
+
 	for (i = 0; apc_cmdtab[i].name != NULL; i++) {
 		/* main command must match */
 		if (strcasecmp(apc_cmdtab[i].name, cmd))
@@ -2128,6 +2277,7 @@ void upsdrv_makevartable(void)
 	addvar(VAR_VALUE, "awd", "hard hibernate's additional wakeup delay");
 	addvar(VAR_VALUE, "sdtype", "specify simple shutdown method (0 - " APC_SDMAX ")");
 	addvar(VAR_VALUE, "advorder", "enable advanced shutdown control");
+	addvar(VAR_FLAG, "schedpoll", "poll fast changing variables first, without blocking");
 }
 
 void upsdrv_initups(void)
@@ -2166,6 +2316,7 @@ void upsdrv_cleanup(void)
 {
 	char temp[APC_LBUF];
 
+	sched_stop();
 	apc_flush(0);
 	/* try to bring the UPS out of smart mode */
 	apc_write(APC_GODUMB);
@@ -2201,6 +2352,13 @@ void upsdrv_initinfo(void)
 	upsdebugx(1, "detected %s [%s] on %s", pmod, pser, device_path);
 
 	setuphandlers();
+
+	/* alerts are now handled by the serial transport */
+	if (testvar("schedpoll")) {
+		sched_mode = 1;
+		extrafd = -1;
+		ser_async_init(upsfd, ALERT_CHARS, alert_handler);
+	}
 }
 
 void upsdrv_updateinfo(void)
@@ -2228,10 +2386,22 @@ void upsdrv_updateinfo(void)
 		last_worked = 0;
 	}
 
-	if (!update_status())
+	time(&now);
+
+	if (sched_mode) {
+		/* refresh all variables hourly, in the background too */
+		if (difftime(now, last_full) > 3600) {
+			last_full = now;
+			update_info_sched(1);
+			return;
+		}
+
+		update_info_sched(0);
 		return;
+	}
 
-	time(&now);
+	if (!update_status())
+		return;
 
 	/* refresh all variables hourly */
 	/* does not catch measure-ups II insertion/removal */
@@ -24,7 +24,7 @@
 #define __apcsmart_h__
 
 #define DRIVER_NAME	"APC Smart protocol driver"
-#define DRIVER_VERSION	"3.04"
+#define DRIVER_VERSION	"3.05"
 
 #define ALT_CABLE_1 "940-0095B"
 
@@ -101,6 +101,12 @@
 #define SER_TO	0x080	/* timeout allowed */
 #define SER_HA	0x100	/* handle asterisk */
 
+/*
+ * scheduled polling: the status and the APC_FAST variables are queried at each
+ * update, the other APC_POLL ones in turn over SCHED_SLOW_CYCLES updates
+ */
+#define SCHED_SLOW_CYCLES	4
+
 
 /* sets of the above (don't test against them, obviously */
 
@@ -25,7 +25,7 @@
 apc_vartab_t apc_vartab[] = {
 
 	{ "ups.temperature",		'C',	APC_POLL|APC_F_CELSIUS },
-	{ "ups.load",			'P',	APC_POLL|APC_F_PERCENT },
+	{ "ups.load",			'P',	APC_POLL|APC_FAST|APC_F_PERCENT },
 	{ "ups.test.interval",		'E',	APC_F_HOURS },
 	{ "ups.test.result",		'X',	APC_POLL },
 	{ "ups.delay.start",		'r',	APC_F_SECONDS },
@@ -33,8 +33,8 @@ apc_vartab_t apc_vartab[] = {
 	{ "ups.id",			'c',	APC_STRING },
 	{ "ups.contacts",		'i',	APC_POLL|APC_F_HEX },
 	{ "ups.display.language",	'\014',	0 },
-	{ "input.voltage",		'L',	APC_POLL|APC_F_VOLT },
-	{ "input.frequency",		'F',	APC_POLL|APC_F_DEC },
+	{ "input.voltage",		'L',	APC_POLL|APC_FAST|APC_F_VOLT },
+	{ "input.frequency",		'F',	APC_POLL|APC_FAST|APC_F_DEC },
 	{ "input.sensitivity",		's',	0 },
 	{ "input.quality",		'9',	APC_POLL|APC_F_HEX },
 	{ "input.transfer.low",		'l',	APC_F_VOLT },
@@ -42,8 +42,8 @@ apc_vartab_t apc_vartab[] = {
 	{ "input.transfer.reason",	'G',	APC_POLL|APC_F_REASON },
 	{ "input.voltage.maximum",	'M',	APC_POLL|APC_F_VOLT },
 	{ "input.voltage.minimum",	'N',	APC_POLL|APC_F_VOLT },
-	{ "output.current",		'/',	APC_POLL|APC_F_AMP },
-	{ "output.voltage",		'O',	APC_POLL|APC_F_VOLT },
+	{ "output.current",		'/',	APC_POLL|APC_FAST|APC_F_AMP },
+	{ "output.voltage",		'O',	APC_POLL|APC_FAST|APC_F_VOLT },
 	{ "output.voltage.nominal",	'o',	APC_F_VOLT },
 	{ "ambient.humidity",		'h',	APC_POLL|APC_F_PERCENT },
 	{ "ambient.humidity.high",	'{',	APC_F_PERCENT },
@@ -52,11 +52,11 @@ apc_vartab_t apc_vartab[] = {
 	{ "ambient.temperature.high",	'[',	APC_F_CELSIUS },
 	{ "ambient.temperature.low",	']',	APC_F_CELSIUS },
 	{ "battery.date",		'x',	APC_STRING },
-	{ "battery.charge",		'f',	APC_POLL|APC_F_PERCENT },
+	{ "battery.charge",		'f',	APC_POLL|APC_FAST|APC_F_PERCENT },
 	{ "battery.charge.restart",	'e',	APC_F_PERCENT },
-	{ "battery.voltage",		'B',	APC_POLL|APC_F_VOLT },
+	{ "battery.voltage",		'B',	APC_POLL|APC_FAST|APC_F_VOLT },
 	{ "battery.voltage.nominal",	'g',	0 },
-	{ "battery.runtime",		'j',	APC_POLL|APC_F_MINUTES },
+	{ "battery.runtime",		'j',	APC_POLL|APC_FAST|APC_F_MINUTES },
 	{ "battery.runtime.low",	'q',	APC_F_MINUTES },
 	{ "battery.packs",		'>',	APC_F_DEC },
 	{ "battery.packs.bad",		'<',	APC_F_DEC },
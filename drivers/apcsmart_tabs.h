@@ -44,6 +44,7 @@
 #define APC_STRING	0x00000800	/* string variable			*/
 #define APC_MULTI	0x00001000	/* there're other vars like that	*/
 #define APC_DEPR	0x00002000	/* deprecated variable			*/
+#define APC_FAST	0x00004000	/* changes fast, poll at each update	*/
 
 /* variables' format */
 
@@ -61,6 +61,19 @@ static struct {
 
 static time_t	lastpoll = 0;
 
+/* last status reply, to skip the ones that didn't change */
+static char	status_reply[SMALLBUF];
+
+/*
+ * Fields of the status and rating replies: space separated numbers, each
+ * converted by .conv and stored with .fmt in .var
+ */
+typedef struct {
+	const char	*var;
+	const char	*fmt;
+	double	(*conv)(const char *, char **);
+} blazer_field_t;
+
 /*
  * This little structure defines the various flavors of the Megatec protocol.
  * Only the .name and .status are mandatory, .rating and .vendor elements are
@@ -163,13 +176,42 @@ static double blazer_packs(const char *ptr, char **endptr)
 }
 
 
+/*
+ * Store the values of a reply (after its start character) as described by
+ * the field table. Returns the value following the last field (if any) in
+ * next, or -1 if the reply is too short.
+ */
+static int blazer_parse(const char *func, char *buf, const blazer_field_t *field, char **next)
+{
+	char	*val, *last = NULL;
+	int	i;
+
+	for (i = 0, val = strtok_r(buf+1, " ", &last); field[i].var; i++, val = strtok_r(NULL, " \r\n", &last)) {
+
+		if (!val) {
+			upsdebugx(2, "%s: parsing failed", func);
+			return -1;
+		}
+
+		if (strspn(val, "0123456789.") != strlen(val)) {
+			upsdebugx(2, "%s: non numerical value [%s]", func, val);
+			continue;
+		}
+
+		dstate_setinfo(field[i].var, field[i].fmt, field[i].conv(val, NULL));
+	}
+
+	if (next) {
+		*next = val;
+	}
+
+	return 0;
+}
+
+
 static int blazer_status(const char *cmd)
 {
-	const struct {
-		const char	*var;
-		const char	*fmt;
-		double	(*conv)(const char *, char **);
-	} status[] = {
+	static const blazer_field_t	status[] = {
 		{ "input.voltage", "%.1f", strtod },
 		{ "input.voltage.fault", "%.1f", strtod },
 		{ "output.voltage", "%.1f", strtod },
@@ -180,8 +222,7 @@ static int blazer_status(const char *cmd)
 		{ NULL }
 	};
 
-	char	buf[SMALLBUF], *val, *last = NULL;
-	int	i;
+	char	reply[SMALLBUF], buf[SMALLBUF], *val;
 
 	/*
 	 * > [Q1\r]
@@ -189,29 +230,28 @@ static int blazer_status(const char *cmd)
 	 *    01234567890123456789012345678901234567890123456
 	 *    0         1         2         3         4
 	 */
-	if (blazer_command(cmd, buf, sizeof(buf)) < 46) {
+	if (blazer_command(cmd, reply, sizeof(reply)) < 46) {
 		upsdebugx(2, "%s: short reply", __func__);
 		return -1;
 	}
 
-	if (buf[0] != '(') {
-		upsdebugx(2, "%s: invalid start character [%02x]", __func__, buf[0]);
-		return -1;
+	/* same reply as last time, so the variables are still up to date */
+	if (!strcmp(reply, status_reply)) {
+		upsdebugx(3, "%s: unchanged", __func__);
+		return 0;
 	}
 
-	for (i = 0, val = strtok_r(buf+1, " ", &last); status[i].var; i++, val = strtok_r(NULL, " \r\n", &last)) {
+	status_reply[0] = '\0';
 
-		if (!val) {
-			upsdebugx(2, "%s: parsing failed", __func__);
-			return -1;
-		}
+	if (reply[0] != '(') {
+		upsdebugx(2, "%s: invalid start character [%02x]", __func__, reply[0]);
+		return -1;
+	}
 
-		if (strspn(val, "0123456789.") != strlen(val)) {
-			upsdebugx(2, "%s: non numerical value [%s]", __func__, val);
-			continue;
-		}
+	snprintf(buf, sizeof(buf), "%s", reply);
 
-		dstate_setinfo(status[i].var, status[i].fmt, status[i].conv(val, NULL));
+	if (blazer_parse(__func__, buf, status, &val)) {
+		return -1;
 	}
 
 	if (!val) {
@@ -289,17 +329,15 @@ static int blazer_status(const char *cmd)
 
 	status_commit();
 
+	snprintf(status_reply, sizeof(status_reply), "%s", reply);
+
 	return 0;
 }
 
 
 static int blazer_rating(const char *cmd)
 {
-	const struct {
-		const char	*var;
-		const char	*fmt;
-		double		(*conv)(const char *, char **);
-	} rating[] = {
+	static const blazer_field_t	rating[] = {
 		{ "input.voltage.nominal", "%.0f", strtod },
 		{ "input.current.nominal", "%.1f", strtod },
 		{ "battery.voltage.nominal", "%.1f", blazer_packs },
@@ -307,8 +345,7 @@ static int blazer_rating(const char *cmd)
 		{ NULL }
 	};
 
-	char	buf[SMALLBUF], *val, *last = NULL;
-	int	i;
+	char	buf[SMALLBUF];
 
 	/*
 	 * > [F\r]
@@ -326,22 +363,7 @@ static int blazer_rating(const char *cmd)
 		return -1;
 	}
 
-	for (i = 0, val = strtok_r(buf+1, " ", &last); rating[i].var; i++, val = strtok_r(NULL, " \r\n", &last)) {
-
-		if (!val) {
-			upsdebugx(2, "%s: parsing failed", __func__);
-			return -1;
-		}
-
-		if (strspn(val, "0123456789.") != strlen(val)) {
-			upsdebugx(2, "%s: non numerical value [%s]", __func__, val);
-			continue;
-		}
-
-		dstate_setinfo(rating[i].var, rating[i].fmt, rating[i].conv(val, NULL));
-	}
-
-	return 0;
+	return blazer_parse(__func__, buf, rating, NULL);
 }
 
 
@@ -704,6 +726,9 @@ void blazer_initinfo(void)
 
 	blazer_initbattery();
 
+	/* the battery settings are known now, parse the next status again */
+	status_reply[0] = '\0';
+
 	dstate_setinfo("ups.delay.start", "%d", 60 * ondelay);
 	dstate_setinfo("ups.delay.shutdown", "%d", offdelay);
 
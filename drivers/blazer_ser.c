@@ -26,7 +26,7 @@
 #include "blazer.h"
 
 #define DRIVER_NAME	"Megatec/Q1 protocol serial driver"
-#define DRIVER_VERSION	"1.55"
+#define DRIVER_VERSION	"1.56"
 
 /* driver description structure */
 upsdrv_info_t upsdrv_info = {
@@ -28,7 +28,7 @@
 #include "blazer.h"
 
 #define DRIVER_NAME	"Megatec/Q1 protocol USB driver"
-#define DRIVER_VERSION	"0.09"
+#define DRIVER_VERSION	"0.10"
 
 /* driver description structure */
 upsdrv_info_t upsdrv_info = {
@@ -396,8 +396,16 @@ int blazer_command(const char *cmd, char *buf, size_t buflen)
 	int	ret;
 
 	if (udev == NULL) {
+		/* scan the bus on hotplug, or with a growing delay */
+		if (!usb_reconnect_due()) {
+			return -1;
+		}
+
 		ret = usb->open(&udev, &usbdevice, reopen_matcher, NULL);
 
+		usb_reconnect_done(ret > 0);
+		extrafd = usb_reconnect_fd();
+
 		if (ret < 1) {
 			return ret;
 		}
@@ -39,6 +39,12 @@
 	static st_tree_t	*dtree_root = NULL;
 	static conn_t	*connhead = NULL;
 	static cmdlist_t *cmdhead = NULL;
+	static unsigned long	changes = 0;
+
+	/* extra event source, see dstate_set_io() */
+	static int	io_fd = -1;
+	static struct timeval	io_timer;
+	static void	(*io_handler)(void) = NULL;
 
 	struct ups_handler	upsh;
 
@@ -519,10 +525,40 @@ void dstate_init(const char *prog, const char *devname)
 	upsdebugx(2, "dstate_init: sock %s open on fd %d", sockname, sockfd);
 }
 
+/* register an extra event source (e.g. the serial transport): the handler
+   is called from dstate_poll_fds() when fd has data, or once the timer
+   (absolute time) has expired */
+void dstate_set_io(int fd, const struct timeval *timer, void (*handler)(void))
+{
+	io_fd = fd;
+	io_handler = handler;
+
+	if (timer) {
+		io_timer = *timer;
+	} else {
+		io_timer.tv_sec = 0;
+		io_timer.tv_usec = 0;
+	}
+}
+
+/* nonzero if the io timer is set and expires before tv */
+static int io_timer_before(const struct timeval *tv)
+{
+	if ((!io_handler) || (io_timer.tv_sec == 0)) {
+		return 0;
+	}
+
+	if (io_timer.tv_sec != tv->tv_sec) {
+		return (io_timer.tv_sec < tv->tv_sec);
+	}
+
+	return (io_timer.tv_usec <= tv->tv_usec);
+}
+
 /* returns 1 if timeout expired or data is available on UPS fd, 0 otherwise */
 int dstate_poll_fds(struct timeval timeout, int extrafd)
 {
-	int	ret, maxfd, overrun = 0;
+	int	ret, maxfd, overrun = 0, io_wake = 0;
 	fd_set	rfds;
 	struct timeval	now;
 	conn_t	*conn, *cnext;
@@ -540,6 +576,20 @@ int dstate_poll_fds(struct timeval timeout, int extrafd)
 		}
 	}
 
+	if ((io_handler) && (io_fd != -1)) {
+		FD_SET(io_fd, &rfds);
+
+		if (io_fd > maxfd) {
+			maxfd = io_fd;
+		}
+	}
+
+	/* wake up early for the io timer */
+	if (io_timer_before(&timeout)) {
+		timeout = io_timer;
+		io_wake = 1;
+	}
+
 	for (conn = connhead; conn; conn = conn->next) {
 		FD_SET(conn->fd, &rfds);
 
@@ -564,10 +614,20 @@ int dstate_poll_fds(struct timeval timeout, int extrafd)
 		timeout.tv_sec -= now.tv_sec;
 		timeout.tv_usec -= now.tv_usec;
 	}
-	
+
+	/* the real timeout is not over yet */
+	if (io_wake) {
+		overrun = 0;
+	}
+
 	ret = select(maxfd + 1, &rfds, NULL, NULL, &timeout);
 
 	if (ret == 0) {
+		if (io_wake) {
+			io_handler();
+			return overrun;
+		}
+
 		return 1;	/* timer expired */
 	}
 
@@ -598,6 +658,14 @@ int dstate_poll_fds(struct timeval timeout, int extrafd)
 		}
 	}
 
+	if (io_handler) {
+		gettimeofday(&now, NULL);
+
+		if (((io_fd != -1) && (FD_ISSET(io_fd, &rfds))) || (io_timer_before(&now))) {
+			io_handler();
+		}
+	}
+
 	/* tell the caller if that fd woke up */
 	if ((extrafd != -1) && (FD_ISSET(extrafd, &rfds))) {
 		return 1;
@@ -620,6 +688,7 @@ int dstate_setinfo(const char *var, const char *fmt, ...)
 
 	if (ret == 1) {
 		send_to_all("SETINFO %s \"%s\"\n", var, value);
+		changes++;
 	}
 
 	return ret;
@@ -744,11 +813,18 @@ int dstate_delinfo(const char *var)
 	/* update listeners */
 	if (ret == 1) {
 		send_to_all("DELINFO %s\n", var);
+		changes++;
 	}
 
 	return ret;
 }
 
+/* number of variables changed or deleted so far */
+unsigned long dstate_changes(void)
+{
+	return changes;
+}
+
 int dstate_delenum(const char *var, const char *val)
 {
 	int	ret;
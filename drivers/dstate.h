@@ -43,6 +43,8 @@ typedef struct conn_s {
 
 void dstate_init(const char *prog, const char *devname);
 int dstate_poll_fds(struct timeval timeout, int extrafd);
+void dstate_set_io(int fd, const struct timeval *timer, void (*handler)(void));
+unsigned long dstate_changes(void);
 int dstate_setinfo(const char *var, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
 int dstate_addenum(const char *var, const char *fmt, ...)
@@ -37,10 +37,11 @@
 #include "main.h"
 #include "parseconf.h"
 #include "upsclient.h"
+#include "trace.h"
 #include "dummy-ups.h"
 
 #define DRIVER_NAME	"Device simulation and repeater driver"
-#define DRIVER_VERSION	"0.13"
+#define DRIVER_VERSION	"0.14"
 
 /* driver description structure */
 upsdrv_info_t upsdrv_info =
@@ -56,6 +57,7 @@ upsdrv_info_t upsdrv_info =
 #define MODE_DUMMY		1 /* use the embedded defintion or a definition file */
 #define MODE_REPEATER	2 /* use libupsclient to repeat an UPS */
 #define MODE_META		3 /* consolidate data from several UPSs (TBS) */
+#define MODE_REPLAY		4 /* play a compiled trace back (see trace.h) */
 
 int mode=MODE_NONE;
 
@@ -65,6 +67,9 @@ time_t		next_update = -1;
 
 #define MAX_STRING_SIZE	128
 
+/* records applied at once, before letting upsd in */
+#define REPLAY_BATCH	1000
+
 static int setvar(const char *varname, const char *val);
 static int instcmd(const char *cmdname, const char *extra);
 static int parse_data_file(int upsfd);
@@ -73,12 +78,21 @@ static int is_valid_data(const char* varname);
 static int is_valid_value(const char* varname, const char *value);
 /* libupsclient update */
 static int upsclient_update_vars(void);
+/* trace replay */
+static void replay_run(void);
 
 /* connection information */
 static char		*client_upsname = NULL, *hostname = NULL;
 static UPSCONN_t	*ups = NULL;
 static int	port;
 
+/* replay mode */
+static trace_t	trace;
+static trace_rec_t	replay_rec;		/* next record to apply */
+static unsigned long long	replay_offset = 0;	/* trace time of the current pass */
+static struct timeval	replay_start;
+static double	speed = 1;
+
 /* Driver functions */
 
 void upsdrv_initinfo(void)
@@ -111,6 +125,28 @@ void upsdrv_initinfo(void)
 
 			dstate_dataok();
 			break;
+		case MODE_REPLAY:
+			for ( item = nut_data ; item->info_type != NULL ; item++ )
+			{
+				if (item->drv_flags & DU_FLAG_INIT)
+				{
+					dstate_setinfo(item->info_type, "%s", item->default_value);
+					dstate_setflags(item->info_type, item->info_flags);
+
+					if (item->info_flags & ST_FLAG_STRING)
+						dstate_setaux(item->info_type, item->info_len);
+				}
+			}
+
+			upsh.setvar = setvar;
+
+			if (trace_next(&trace, &replay_rec) != 1)
+				fatalx(EXIT_FAILURE, "Trace %s is empty", device_path);
+
+			/* apply the start of the trace, the rest comes from the timer */
+			gettimeofday(&replay_start, NULL);
+			replay_run();
+			break;
 		case MODE_META:
 		case MODE_REPEATER:
 			/* Obtain the target name */
@@ -153,6 +189,10 @@ void upsdrv_updateinfo(void)
 {
 	upsdebugx(1, "upsdrv_updateinfo...");
 
+	/* replay_run() is called from the main loop at the right time */
+	if (mode == MODE_REPLAY)
+		return;
+
 	sleep(1);
 
 	switch (mode)
@@ -216,10 +256,13 @@ void upsdrv_help(void)
 
 void upsdrv_makevartable(void)
 {
+	addvar(VAR_VALUE, "speed", "Replay speed factor of a trace (default: 1)");
 }
 
 void upsdrv_initups(void)
 {
+	char	fn[SMALLBUF];
+
 	/* check the running mode... */
 	if (strchr(device_path, '@'))
 	{
@@ -227,17 +270,44 @@ void upsdrv_initups(void)
 		mode = MODE_REPEATER;
 		dstate_setinfo("driver.parameter.mode", "repeater");
 		/* FIXME: if there is at least one more => MODE_META... */
+		return;
 	}
+
+	if (device_path[0] == '/')
+		snprintf(fn, sizeof(fn), "%s", device_path);
 	else
+		snprintf(fn, sizeof(fn), "%s/%s", confpath(), device_path);
+
+	/* a compiled trace rather than a definition file */
+	if (trace_open(&trace, fn) == 0)
 	{
-		upsdebugx(1, "Dummy (simulation) mode");
-		mode = MODE_DUMMY;
-		dstate_setinfo("driver.parameter.mode", "dummy");
+		upsdebugx(1, "Replay mode");
+		mode = MODE_REPLAY;
+		dstate_setinfo("driver.parameter.mode", "replay");
+
+		if (getval("speed"))
+		{
+			speed = atof(getval("speed"));
+
+			if (speed <= 0)
+				fatalx(EXIT_FAILURE, "Invalid speed: %s", getval("speed"));
+		}
+		return;
 	}
+
+	upsdebugx(1, "Dummy (simulation) mode");
+	mode = MODE_DUMMY;
+	dstate_setinfo("driver.parameter.mode", "dummy");
 }
 
 void upsdrv_cleanup(void)
 {
+	if (mode == MODE_REPLAY)
+	{
+		dstate_set_io(-1, NULL, NULL);
+		trace_close(&trace);
+	}
+
 	if ( (mode == MODE_META) || (mode == MODE_REPEATER) )
 	{
 		if (ups)
@@ -409,6 +479,112 @@ static int is_valid_value(const char* varname, const char *value)
 	/* return 0;*/
 }
 
+/* for replay mode
+ * apply a trace record */
+static void replay_apply(const trace_rec_t *rec)
+{
+	/* Skip the driver.* collection data */
+	if (!strncmp(rec->var, "driver.", 7))
+		return;
+
+	switch (rec->type)
+	{
+		case TRACE_SETINFO:
+			setvar(rec->var, rec->val);
+			break;
+		case TRACE_DELINFO:
+			dstate_delinfo(rec->var);
+			break;
+		default:
+			break;
+	}
+}
+
+/* read the next record, looping back at the end of the trace;
+ * returns 0 when there is nothing more to play */
+static int replay_next(void)
+{
+	unsigned long long	duration = trace.usec;
+	int	ret;
+
+	ret = trace_next(&trace, &replay_rec);
+
+	if (ret > 0)
+		return 1;
+
+	if (ret < 0)
+		upslogx(LOG_WARNING, "Trace %s is truncated", device_path);
+
+	/* a trace without timing is only a static definition */
+	if (duration == 0)
+		return 0;
+
+	trace_rewind(&trace);
+	replay_offset += duration;
+
+	upsdebugx(1, "replay: looping back at the beginning of the trace");
+
+	return (trace_next(&trace, &replay_rec) == 1);
+}
+
+/* for replay mode
+ * apply the records that are due, and schedule the next ones
+ * (called from the main loop through dstate_set_io) */
+static void replay_run(void)
+{
+	struct timeval	now, next;
+	unsigned long long	elapsed, due;
+	double	sec;
+	int	count;
+
+	gettimeofday(&now, NULL);
+
+	elapsed = ((now.tv_sec - replay_start.tv_sec) * 1e6 +
+		(now.tv_usec - replay_start.tv_usec)) * speed;
+
+	for (count = 0; count < REPLAY_BATCH; count++)
+	{
+		due = replay_offset + replay_rec.usec;
+
+		if (due > elapsed)
+			break;
+
+		replay_apply(&replay_rec);
+
+		if (!replay_next())
+		{
+			upsdebugx(1, "replay: end of the trace");
+			dstate_set_io(-1, NULL, NULL);
+			dstate_dataok();
+			return;
+		}
+	}
+
+	dstate_dataok();
+
+	if (count == REPLAY_BATCH)
+	{
+		/* more is due, but let upsd in first */
+		next = now;
+	}
+	else
+	{
+		sec = due / 1e6 / speed;
+
+		next = replay_start;
+		next.tv_sec += (time_t)sec;
+		next.tv_usec += (sec - (time_t)sec) * 1e6;
+
+		if (next.tv_usec >= 1000000)
+		{
+			next.tv_sec++;
+			next.tv_usec -= 1000000;
+		}
+	}
+
+	dstate_set_io(-1, &next, replay_run);
+}
+
 /* called for fatal errors in parseconf like malloc failures */
 static void upsconf_err(const char *errmsg)
 {
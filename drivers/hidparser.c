@@ -35,6 +35,24 @@
 
 static const uint8_t ItemSize[4] = { 0, 1, 2, 4 };
 
+/* Units and exponents table (HID PDC, 3.2.3) */
+#define NB_HID_UNITS 10
+static struct {
+	const long	Type;
+	const int8_t	Expo;
+} HIDUnits[NB_HID_UNITS] = {
+	{ 0x00000000, 0 },	/* None */
+	{ 0x00F0D121, 7 },	/* Voltage */
+	{ 0x00100001, 0 },	/* Ampere */
+	{ 0x0000D121, 7 },	/* VA */
+	{ 0x0000D121, 7 },	/* Watts */
+	{ 0x00001001, 0 },	/* second */
+	{ 0x00010001, 0 },	/* K */
+	{ 0x00000000, 0 },	/* percent */
+	{ 0x0000F001, 0 },	/* Hertz */
+	{ 0x00101001, 0 },	/* As */
+};
+
 /*
  * HIDParser struct
  * -------------------------------------------------------------------------- */
@@ -142,6 +160,67 @@ static long FormatValue(long Value, uint8_t Size)
 	}
 }
 
+/* exponent function: return a^b */
+static double exponent(double a, int8_t b)
+{
+	if (b>0)
+		return (a * exponent(a, --b));		/* a * a ... */
+
+	if (b<0)
+		return ((1/a) * exponent(a, ++b));	/* (1/a) * (1/a) ... */
+
+	return 1;
+}
+
+/*
+ * set_conversion(HIDData_t *pData)
+ *
+ * Compute the logical to physical conversion of pData once, so that
+ * reading a value (logical_to_physical() in libhid.c) is a single
+ * multiply-add.
+ * -------------------------------------------------------------------------- */
+static void set_conversion(HIDData_t *pData)
+{
+	int	i;
+	int8_t	unit_expo = pData->UnitExp;
+	double	Factor;
+
+	for (i = 0; i < NB_HID_UNITS; i++) {
+
+		if (HIDUnits[i].Type == pData->Unit) {
+			unit_expo -= HIDUnits[i].Expo;
+			break;
+		}
+	}
+
+	pData->UnitFactor = exponent(10, unit_expo);
+
+	/* HID spec says that if one or both are undefined, or if they are
+	 * both 0, then PhyMin = LogMin, PhyMax = LogMax. */
+	pData->have_Range = 1;
+
+	if (!pData->have_PhyMax || !pData->have_PhyMin ||
+		(pData->PhyMax == 0 && pData->PhyMin == 0)) {
+		pData->have_Range = 0;
+	}
+
+	/* Paranoia: this should not really happen */
+	if ((pData->PhyMax <= pData->PhyMin) || (pData->LogMax <= pData->LogMin)) {
+		pData->have_Range = 0;
+	}
+
+	if (!pData->have_Range) {
+		pData->PhyScale = pData->UnitFactor;
+		pData->PhyOffset = 0;
+		return;
+	}
+
+	Factor = (double)(pData->PhyMax - pData->PhyMin) / (pData->LogMax - pData->LogMin);
+
+	pData->PhyScale = Factor * pData->UnitFactor;
+	pData->PhyOffset = (pData->PhyMin - pData->LogMin * Factor) * pData->UnitFactor;
+}
+
 /*
  * HIDParse(HIDParser_t* pParser, HIDData_t *pData)
  *
@@ -277,6 +356,7 @@ static int HIDParse(HIDParser_t *pParser, HIDData_t *pData)
 			/* Get Object in pData */
 			/* -------------------------------------------------------------------------- */
 			memcpy(pData, &pParser->Data, sizeof(HIDData_t));
+			set_conversion(pData);
 			/* -------------------------------------------------------------------------- */
 			
 			/* Increment Report Offset */
@@ -131,6 +131,12 @@ typedef struct {
 	long		PhyMax;				/* Physical Max			*/
 	int8_t		have_PhyMin;			/* Physical Min defined?		*/
 	int8_t		have_PhyMax;			/* Physical Max defined?		*/
+
+	/* Precomputed when parsing: Physical = Logical * PhyScale + PhyOffset */
+	int8_t		have_Range;			/* Logical to Physical range?	*/
+	double		UnitFactor;			/* 10 ^ (Unit exponent)		*/
+	double		PhyScale;			/* Range and Unit factors		*/
+	double		PhyOffset;			/* Physical at Logical 0		*/
 } HIDData_t;
 
 /*
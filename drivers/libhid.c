@@ -53,8 +53,6 @@ static const char *hid_lookup_path(const HIDNode_t usage, usage_tables_t *utab);
 static long hid_lookup_usage(const char *name, usage_tables_t *utab);
 static int string_to_path(const char *string, HIDPath_t *path, usage_tables_t *utab);
 static int path_to_string(char *string, size_t size, const HIDPath_t *path, usage_tables_t *utab);
-static int8_t get_unit_expo(const HIDData_t *hiddata);
-static double exponent(double a, int8_t b);
 
 /* Tweak flag for APC Back-UPS */
 int max_report_size = 0;
@@ -135,6 +133,23 @@ reportbuf_t *new_report_buffer(HIDDesc_t *pDesc)
 /* the functions in this next group operate on buffered reports, but
    operate on individual items, not whole reports. */
 
+/* timestamp for the report buffer, in seconds. Use a monotonic clock
+   when available, so reports don't expire on system time changes. */
+static double report_time(void)
+{
+	struct timeval	tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec	now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+		return now.tv_sec + (double)now.tv_nsec / 1000000000;
+	}
+#endif
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
 /* refresh the report with the given id in the report buffer rbuf.  If
    the report is not yet in the buffer, or if it is older than "age"
    seconds, then the report is freshly read from the USB
@@ -143,12 +158,11 @@ reportbuf_t *new_report_buffer(HIDDesc_t *pDesc)
 /* because buggy firmwares from APC return wrong report size, we either
    ask the report with the found report size or with the whole buffer size
    depending on the max_report_size flag */
-static int refresh_report_buffer(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDData_t *pData, int age)
+static int refresh_report_buffer(reportbuf_t *rbuf, hid_dev_handle_t udev, int id, int age)
 {
-	int	id = pData->ReportID;
 	int	r;
 
-	if (rbuf->ts[id] + age > time(NULL)) {
+	if ((rbuf->ts[id] > 0) && (rbuf->ts[id] + age > report_time())) {
 		/* buffered report is still good; nothing to do */
 		upsdebug_hex(3, "Report[buf]", rbuf->data[id], rbuf->len[id]);
 		return 0;
@@ -169,7 +183,7 @@ static int refresh_report_buffer(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDDa
 	}
 
 	/* have (valid) report */
-	time(&rbuf->ts[id]);
+	rbuf->ts[id] = report_time();
 
 	return 0;
 }
@@ -183,7 +197,7 @@ static int get_item_buffered(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDData_t
 	int id = pData->ReportID;
 	int r;
 
-	r = refresh_report_buffer(rbuf, udev, pData, age);
+	r = refresh_report_buffer(rbuf, udev, id, age);
 	if (r<0) {
 		return -1;
 	}
@@ -235,33 +249,13 @@ static int file_report_buffer(reportbuf_t *rbuf, unsigned char *buf, int buflen)
 	}
 
 	/* have (valid) report */
-	time(&rbuf->ts[id]);
+	rbuf->ts[id] = report_time();
 
 	return 0;
 }
 
 /* ---------------------------------------------------------------------- */
 
-/* Units and exponents table (HID PDC, 3.2.3) */
-#define NB_HID_UNITS 10
-static struct {
-	const long	Type;
-	const int8_t	Expo;
-} HIDUnits[NB_HID_UNITS] = {
-	{ 0x00000000, 0 },	/* None */
-	{ 0x00F0D121, 7 },	/* Voltage */
-	{ 0x00100001, 0 },	/* Ampere */
-	{ 0x0000D121, 7 },	/* VA */
-	{ 0x0000D121, 7 },	/* Watts */
-	{ 0x00001001, 0 },	/* second */
-	{ 0x00010001, 0 },	/* K */
-	{ 0x00000000, 0 },	/* percent */
-	{ 0x0000F001, 0 },	/* Hertz */
-	{ 0x00101001, 0 },	/* As */
-};
-
-/* ---------------------------------------------------------------------- */
-
 /* CAUTION: be careful when modifying the output format of this function,
  * since it's used to produce sub-drivers "stub" using
  * scripts/subdriver/gen-usbhid-subdriver.sh
@@ -359,6 +353,25 @@ char *HIDGetDataItem(const HIDData_t *hiddata, usage_tables_t *utab)
 	return itemPath;
 }
 
+/* Read the report with the given ID, unless the buffered one is less
+ * than age seconds old (0 to always read it). Items of this report can
+ * then be decoded from the buffer with HIDGetDataValue().
+ * return 1 if OK, -errno otherwise (ie disconnect).
+ */
+int HIDRefreshReport(hid_dev_handle_t udev, int ReportID, int age)
+{
+	if ((ReportID < 0) || (ReportID > 255) || (reportbuf->data[ReportID] == NULL)) {
+		return -EINVAL;
+	}
+
+	if (refresh_report_buffer(reportbuf, udev, ReportID, age) < 0) {
+		upsdebug_with_errno(1, "Can't retrieve Report %02x", ReportID);
+		return -errno;
+	}
+
+	return 1;
+}
+
 /* Return the physical value associated with the given HIDData path.
  * return 1 if OK, 0 on fail, -errno otherwise (ie disconnect).
  */
@@ -377,13 +390,9 @@ int HIDGetDataValue(hid_dev_handle_t udev, HIDData_t *hiddata, double *Value, in
 		return -errno;
 	}
 
-	*Value = hValue;
-	
-	/* Convert Logical Min, Max and Value into Physical */
+	/* Convert Logical Min, Max and Value into Physical (including
+	 * exponents and units) */
 	*Value = logical_to_physical(hiddata, hValue);
-	
-	/* Process exponents and units */
-	*Value *= exponent(10, get_unit_expo(hiddata));
 
 	return 1;
 }
@@ -440,7 +449,7 @@ int HIDSetDataValue(hid_dev_handle_t udev, HIDData_t *hiddata, double Value)
 	}
 
 	/* Process exponents and units */
-	Value /= exponent(10, get_unit_expo(hiddata));
+	Value /= hiddata->UnitFactor;
 	
 	/* Convert Physical Min, Max and Value into Logical */
 	hValue = physical_to_logical(hiddata, Value);
@@ -474,9 +483,7 @@ bool_t HIDSetItemValue(hid_dev_handle_t udev, const char *hidpath, double Value,
 int HIDGetEvents(hid_dev_handle_t udev, HIDData_t **event, int eventsize)
 {
 	unsigned char	buf[SMALLBUF];
-	int		itemCount = 0;
-	int		buflen, r, i;
-	HIDData_t	*pData;
+	int		buflen;
 
 	/* needs libusb-0.1.8 to work => use ifdef and autoconf */
 	buflen = comm_driver->get_interrupt(udev, buf, sizeof(buf), 250);
@@ -484,6 +491,18 @@ int HIDGetEvents(hid_dev_handle_t udev, HIDData_t **event, int eventsize)
 		return buflen;	/* propagate "error" or "no event" code */
 	}
 
+	return HIDParseEvents(buf, buflen, event, eventsize);
+}
+
+/* Same as HIDGetEvents, for an interrupt report that was read elsewhere
+ * (ie by the usbhid-ups interrupt reader thread).
+ */
+int HIDParseEvents(unsigned char *buf, int buflen, HIDData_t **event, int eventsize)
+{
+	int		itemCount = 0;
+	int		r, i;
+	HIDData_t	*pData;
+
 	r = file_report_buffer(reportbuf, buf, buflen);
 	if (r < 0) {
 		upsdebug_with_errno(1, "%s: failed to buffer report", __func__);
@@ -524,42 +543,21 @@ int HIDGetEvents(hid_dev_handle_t udev, HIDData_t **event, int eventsize)
  * Support functions
  *******************************************************/
 
+/* The conversion factors are computed when parsing the report
+ * descriptor (see set_conversion() in hidparser.c) */
 static double logical_to_physical(HIDData_t *Data, long logical)
 {
-	double physical;
-	double Factor;
-
-	upsdebugx(5, "PhyMax = %ld, PhyMin = %ld, LogMax = %ld, LogMin = %ld",
-		Data->PhyMax, Data->PhyMin, Data->LogMax, Data->LogMin);
-
-	/* HID spec says that if one or both are undefined, or if they are
-	 * both 0, then PhyMin = LogMin, PhyMax = LogMax. */
-	if (!Data->have_PhyMax || !Data->have_PhyMin ||
-		(Data->PhyMax == 0 && Data->PhyMin == 0))
-	{
-		return (double)logical;
-	}
-
-	/* Paranoia */
-	if ((Data->PhyMax <= Data->PhyMin) || (Data->LogMax <= Data->LogMin))
-	{
-		/* this should not really happen */
-		return (double)logical;
-	}
-	
-	Factor = (double)(Data->PhyMax - Data->PhyMin) / (Data->LogMax - Data->LogMin);
-	/* Convert Value */
-	physical = (double)((logical - Data->LogMin) * Factor) + Data->PhyMin;
-
-	if (physical > Data->PhyMax) {
-		return Data->PhyMax;
-	}
+	if (Data->have_Range) {
+		if (logical > Data->LogMax) {
+			logical = Data->LogMax;
+		}
 
-	if (physical < Data->PhyMin) {
-		return Data->PhyMin;
+		if (logical < Data->LogMin) {
+			logical = Data->LogMin;
+		}
 	}
 
-	return physical;
+	return logical * Data->PhyScale + Data->PhyOffset;
 }
 
 static long physical_to_logical(HIDData_t *Data, double physical)
@@ -570,18 +568,9 @@ static long physical_to_logical(HIDData_t *Data, double physical)
 	upsdebugx(5, "PhyMax = %ld, PhyMin = %ld, LogMax = %ld, LogMin = %ld",
 		Data->PhyMax, Data->PhyMin, Data->LogMax, Data->LogMin);
 
-	/* HID spec says that if one or both are undefined, or if they are
-	 * both 0, then PhyMin = LogMin, PhyMax = LogMax. */
-	if (!Data->have_PhyMax || !Data->have_PhyMin ||
-		(Data->PhyMax == 0 && Data->PhyMin == 0))
-	{
-		return (long)physical;
-	}
-
-	/* Paranoia */
-	if ((Data->PhyMax <= Data->PhyMin) || (Data->LogMax <= Data->LogMin))
+	/* PhyMin = LogMin, PhyMax = LogMax (see set_conversion()) */
+	if (!Data->have_Range)
 	{
-		/* this should not really happen */
 		return (long)physical;
 	}
 	
@@ -598,37 +587,6 @@ static long physical_to_logical(HIDData_t *Data, double physical)
 	return logical;
 }
 
-static int8_t get_unit_expo(const HIDData_t *hiddata)
-{
-	int	i;
-	int8_t	unit_expo = hiddata->UnitExp;
-
-	upsdebugx(5, "Unit = %08x, UnitExp = %d", (uint32_t)(hiddata->Unit), hiddata->UnitExp);
-
-	for (i = 0; i < NB_HID_UNITS; i++) {
-
-		if (HIDUnits[i].Type == hiddata->Unit) {
-			unit_expo -= HIDUnits[i].Expo;
-			break;
-		}
-	}
-
-	upsdebugx(5, "Exponent = %d", unit_expo);
-	return unit_expo;
-}
-
-/* exponent function: return a^b */
-static double exponent(double a, int8_t b)
-{
-	if (b>0)
-		return (a * exponent(a, --b));		/* a * a ... */
-
-	if (b<0)
-		return ((1/a) * exponent(a, ++b));	/* (1/a) * (1/a) ... */
-
-	return 1;
-}
-
 /* translate HID string path to numeric path and return path depth */
 static int string_to_path(const char *string, HIDPath_t *path, usage_tables_t *utab)
 {
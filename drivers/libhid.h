@@ -82,7 +82,7 @@ extern HIDDesc_t	*pDesc;	/* parsed Report Descriptor */
 /* report buffer structure: holds data about most recent report for
    each given report id */
 typedef struct reportbuf_s {
-       time_t	ts[256];			/* timestamp when report was retrieved */
+       double	ts[256];			/* timestamp when report was retrieved (0 if never) */
        int	len[256];			/* size of report data */
        unsigned char	*data[256];		/* report data (allocated) */
 } reportbuf_t;
@@ -116,6 +116,11 @@ HIDData_t *HIDGetItemData(const char *hidpath, usage_tables_t *utab);
  * -------------------------------------------------------------------------- */
 char *HIDGetDataItem(const HIDData_t *hiddata, usage_tables_t *utab);
 
+/*
+ * HIDRefreshReport
+ * -------------------------------------------------------------------------- */
+int HIDRefreshReport(hid_dev_handle_t udev, int ReportID, int age);
+
 /*
  * HIDGetDataValue
  * -------------------------------------------------------------------------- */
@@ -135,6 +140,7 @@ char *HIDGetIndexString(hid_dev_handle_t udev, int Index, char *buf, size_t bufl
  * HIDGetEvents
  * -------------------------------------------------------------------------- */
 int HIDGetEvents(hid_dev_handle_t udev, HIDData_t **event, int eventlen);
+int HIDParseEvents(unsigned char *buf, int buflen, HIDData_t **event, int eventlen);
 
 /*
  * Support functions
@@ -30,15 +30,21 @@
 
 #include "config.h" /* for HAVE_USB_DETACH_KERNEL_DRIVER_NP flag */
 #include "common.h" /* for xmalloc, upsdebugx prototypes */
+#include "main.h" /* for perf_io (main-hal.c in HAL drivers) */
 #include "usb-common.h"
 #include "libusb.h"
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
 /* USB standard state 5000, but we've decreased it to
  * improve reactivity */
 #define USB_TIMEOUT 4000
 
 #define USB_DRIVER_NAME		"USB communication driver"
-#define USB_DRIVER_VERSION	"0.31"
+#define USB_DRIVER_VERSION	"0.32"
 
 /* driver description structure */
 upsdrv_info_t comm_upsdrv_info = {
@@ -392,6 +398,7 @@ static int libusb_strerror(const int ret, const char *desc)
 
 static int libusb_get_report(usb_dev_handle *udev, int ReportId, unsigned char *raw_buf, int ReportSize )
 {
+	double	start;
 	int	ret;
 
 	upsdebugx(4, "Entering libusb_get_report");
@@ -400,12 +407,16 @@ static int libusb_get_report(usb_dev_handle *udev, int ReportId, unsigned char *
 		return 0;
 	}
 
+	start = monotime();
+
 	ret = usb_control_msg(udev,
 		USB_ENDPOINT_IN + USB_TYPE_CLASS + USB_RECIP_INTERFACE,
 		0x01, /* HID_REPORT_GET */
 		ReportId+(0x03<<8), /* HID_REPORT_TYPE_FEATURE */
 		0, raw_buf, ReportSize, USB_TIMEOUT);
 
+	perf_io(start);
+
 	/* Ignore "protocol stall" (for unsupported request) on control endpoint */
 	if (ret == -EPIPE) {
 		return 0;
@@ -416,18 +427,23 @@ static int libusb_get_report(usb_dev_handle *udev, int ReportId, unsigned char *
 
 static int libusb_set_report(usb_dev_handle *udev, int ReportId, unsigned char *raw_buf, int ReportSize )
 {
+	double	start;
 	int	ret;
 
 	if (!udev) {
 		return 0;
 	}
 
+	start = monotime();
+
 	ret = usb_control_msg(udev,
 		USB_ENDPOINT_OUT + USB_TYPE_CLASS + USB_RECIP_INTERFACE,
 		0x09, /* HID_REPORT_SET = 0x09*/
 		ReportId+(0x03<<8), /* HID_REPORT_TYPE_FEATURE */
 		0, raw_buf, ReportSize, USB_TIMEOUT);
 
+	perf_io(start);
+
 	/* Ignore "protocol stall" (for unsupported request) on control endpoint */
 	if (ret == -EPIPE) {
 		return 0;
@@ -438,13 +454,16 @@ static int libusb_set_report(usb_dev_handle *udev, int ReportId, unsigned char *
 
 static int libusb_get_string(usb_dev_handle *udev, int StringIdx, char *buf, size_t buflen)
 {
+	double start;
 	int ret;
 
 	if (!udev) {
 		return -1;
 	}
 
+	start = monotime();
 	ret = usb_get_string_simple(udev, StringIdx, buf, buflen);
+	perf_io(start);
 
 	return libusb_strerror(ret, __func__);
 }
@@ -490,3 +509,142 @@ usb_communication_subdriver_t usb_subdriver = {
 	libusb_get_string,
 	libusb_get_interrupt
 };
+
+/* ---------------------------------------------------------------------- */
+/* Reconnection pacing: once the device is gone, drivers ask
+ * usb_reconnect_due() before scanning the bus again. On Linux, the
+ * kernel hotplug notifications (netlink uevents) tell when a USB device
+ * is added, so that the scan can be done right away. Otherwise, and as a
+ * fallback for missed notifications, the scans are spaced out with an
+ * exponential backoff. */
+
+#define RECONNECT_MAXDELAY	60	/* seconds */
+
+static int	reconnecting = 0;
+static int	hotplug_fd = -1;
+static int	reconnect_delay = 0;
+static time_t	reconnect_next = 0;
+
+static int hotplug_open(void)
+{
+#ifdef __linux__
+	struct sockaddr_nl	snl;
+	int	fd;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		upsdebug_with_errno(2, "%s: can't open netlink socket", __func__);
+		return -1;
+	}
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = 1;	/* kernel uevents */
+
+	if (bind(fd, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+		upsdebug_with_errno(2, "%s: can't bind netlink socket", __func__);
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+/* read the pending uevents, return 1 if a USB device was added */
+static int hotplug_added(int fd)
+{
+#ifdef __linux__
+	char	buf[4096], *ptr;
+	ssize_t	len;
+	int	added = 0;
+
+	while ((len = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+
+		buf[len] = '\0';
+
+		/* "ACTION@DEVPATH", then NUL separated KEY=VALUE pairs */
+		if (strncmp(buf, "add@", 4)) {
+			continue;
+		}
+
+		for (ptr = buf; ptr < buf + len; ptr += strlen(ptr) + 1) {
+
+			if (!strcmp(ptr, "DEVTYPE=usb_device")) {
+				upsdebugx(2, "USB device added: %s", &buf[4]);
+				added = 1;
+				break;
+			}
+		}
+	}
+
+	return added;
+#else
+	return 0;
+#endif
+}
+
+/* return 1 if the bus should be scanned now for the lost device */
+int usb_reconnect_due(void)
+{
+	time_t	now;
+
+	time(&now);
+
+	/* just lost the device: try right away */
+	if (!reconnecting) {
+		reconnecting = 1;
+		reconnect_delay = 0;
+		hotplug_fd = hotplug_open();
+
+		upsdebugx(2, "%s: waiting for the device %s", __func__,
+			(hotplug_fd < 0) ? "(no hotplug notifications)" : "(with hotplug notifications)");
+		return 1;
+	}
+
+	if ((hotplug_fd >= 0) && hotplug_added(hotplug_fd)) {
+		reconnect_delay = 0;
+		return 1;
+	}
+
+	return (now >= reconnect_next);
+}
+
+/* tell the outcome of the scan */
+void usb_reconnect_done(int success)
+{
+	if (success) {
+		if (hotplug_fd >= 0) {
+			close(hotplug_fd);
+		}
+
+		hotplug_fd = -1;
+		reconnecting = 0;
+		return;
+	}
+
+	/* backoff, starting from the poll interval */
+	if (reconnect_delay < 1) {
+		reconnect_delay = (poll_interval > 0) ? poll_interval : 1;
+	} else {
+		reconnect_delay *= 2;
+	}
+
+	if (reconnect_delay > RECONNECT_MAXDELAY) {
+		reconnect_delay = RECONNECT_MAXDELAY;
+	}
+
+	reconnect_next = time(NULL) + reconnect_delay;
+
+	upsdebugx(2, "%s: next scan in %d seconds (or on hotplug)", __func__, reconnect_delay);
+}
+
+/* file descriptor to wait on for hotplug notifications (-1 if none) */
+int usb_reconnect_fd(void)
+{
+	return hotplug_fd;
+}
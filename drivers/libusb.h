@@ -62,5 +62,10 @@ typedef struct usb_communication_subdriver_s {
 
 extern usb_communication_subdriver_t	usb_subdriver;
 
+/* pacing of the reconnection attempts (hotplug or backoff) */
+int usb_reconnect_due(void);
+void usb_reconnect_done(int success);
+int usb_reconnect_fd(void);
+
 #endif /* LIBUSB_H */
 
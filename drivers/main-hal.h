@@ -11,6 +11,9 @@ extern const char *device_name;
 extern int	upsfd, extrafd, broken_driver, experimental_driver, exit_flag;
 extern unsigned int	poll_interval;
 
+/* driver.perf.* instrumentation, not available with HAL */
+void perf_io(double start);
+
 /* functions & variables required in each driver */
 void upsdrv_initups(void);	/* open connection to UPS, fail if not found */
 void upsdrv_initinfo(void);	/* prep data, settings for UPS monitoring */
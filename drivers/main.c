@@ -46,6 +46,94 @@
 	/* everything else */
 	static char	*pidfn = NULL;
 
+	/* driver.perf.* instrumentation, enabled by the perfstats flag */
+#define PERF_BUCKETS	6
+
+	static int	perfstats = 0;
+	static struct {
+		unsigned long	count;		/* update cycles */
+		unsigned long	overruns;	/* cycles longer than pollinterval */
+		double	total;
+		double	max;
+		unsigned long	bucket[PERF_BUCKETS];	/* 1ms ... 10s and above */
+		unsigned long	io_count;	/* device exchanges */
+		double	io_total;
+		double	io_max;
+	} perf;
+
+void perf_io(double start)
+{
+	double	elapsed;
+
+	if (!perfstats) {
+		return;
+	}
+
+	elapsed = monotime() - start;
+
+	perf.io_count++;
+	perf.io_total += elapsed;
+
+	if (elapsed > perf.io_max) {
+		perf.io_max = elapsed;
+	}
+}
+
+/* account an update cycle and publish the driver.perf.* variables */
+static void perf_update(double start, unsigned long changes, unsigned long io_count, double io_total)
+{
+	const char	*bucket_name[PERF_BUCKETS] = { "1ms", "10ms", "100ms", "1s", "10s", "inf" };
+	char	hist[SMALLBUF];
+	double	elapsed, limit;
+	size_t	len = 0;
+	int	i;
+
+	elapsed = monotime() - start;
+
+	/* what this cycle did */
+	changes = dstate_changes() - changes;
+	io_count = perf.io_count - io_count;
+	io_total = perf.io_total - io_total;
+
+	perf.count++;
+	perf.total += elapsed;
+
+	if (elapsed > perf.max) {
+		perf.max = elapsed;
+	}
+
+	for (i = 0, limit = 1e-3; (i < PERF_BUCKETS - 1) && (elapsed >= limit); i++, limit *= 10)
+		;
+
+	perf.bucket[i]++;
+
+	if (elapsed > poll_interval) {
+		perf.overruns++;
+		upsdebugx(1, "Update took %.3f seconds, more than pollinterval", elapsed);
+	}
+
+	for (i = 0; i < PERF_BUCKETS; i++) {
+		len += snprintf(&hist[len], sizeof(hist) - len, "%s%s:%lu",
+			i ? " " : "", bucket_name[i], perf.bucket[i]);
+	}
+
+	dstate_setinfo("driver.perf.update.count", "%lu", perf.count);
+	dstate_setinfo("driver.perf.update.last", "%.6f", elapsed);
+	dstate_setinfo("driver.perf.update.avg", "%.6f", perf.total / perf.count);
+	dstate_setinfo("driver.perf.update.max", "%.6f", perf.max);
+	dstate_setinfo("driver.perf.update.hist", "%s", hist);
+	dstate_setinfo("driver.perf.update.overruns", "%lu", perf.overruns);
+	dstate_setinfo("driver.perf.update.changes", "%lu", changes);
+
+	dstate_setinfo("driver.perf.io.count", "%lu", io_count);
+	dstate_setinfo("driver.perf.io.wait", "%.6f", io_total);
+
+	if (perf.io_count > 0) {
+		dstate_setinfo("driver.perf.io.latency.avg", "%.6f", perf.io_total / perf.io_count);
+		dstate_setinfo("driver.perf.io.latency.max", "%.6f", perf.io_max);
+	}
+}
+
 /* print the driver banner */
 void upsdrv_banner (void)
 {
@@ -263,6 +351,12 @@ static int main_arg(char *var, char *val)
 		return 1;	/* handled */
 	}
 
+	if (!strcmp(var, "perfstats")) {
+		perfstats = 1;
+		dstate_setinfo("driver.flag.perfstats", "enabled");
+		return 1;	/* handled */
+	}
+
 	/* any other flags are for the driver code */
 	if (!val)
 		return 0;
@@ -673,15 +767,30 @@ int main(int argc, char **argv)
 		writepid(pidfn);	/* PID changes when backgrounding */
 	}
 
+	/* don't let the logging slow down the polling */
+	upslog_async();
+
 	while (!exit_flag) {
 
 		struct timeval	timeout;
+		double	start;
+		unsigned long	changes, io_count;
+		double	io_total;
 
 		gettimeofday(&timeout, NULL);
 		timeout.tv_sec += poll_interval;
 
+		start = monotime();
+		changes = dstate_changes();
+		io_count = perf.io_count;
+		io_total = perf.io_total;
+
 		upsdrv_updateinfo();
 
+		if (perfstats) {
+			perf_update(start, changes, io_count, io_total);
+		}
+
 		while (!dstate_poll_fds(timeout, extrafd) && !exit_flag) {
 			/* repeat until time is up or extrafd has data */
 		}
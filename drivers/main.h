@@ -12,6 +12,10 @@ extern char		*device_path;
 extern int		upsfd, extrafd, broken_driver, experimental_driver, do_lock_port, exit_flag;
 extern unsigned int	poll_interval;
 
+/* driver.perf.* instrumentation: time device exchanges (round trips) with
+   start = monotime(); ...; perf_io(start); */
+void perf_io(double start);
+
 /* functions & variables required in each driver */
 void upsdrv_initups(void);	/* open connection to UPS, fail if not found */
 void upsdrv_initinfo(void);	/* prep data, settings for UPS monitoring */
@@ -21,6 +21,7 @@
 #include "timehead.h"
 #include "serial.h"
 #include "main.h"
+#include "dstate.h"
 
 #include <grp.h>
 #include <pwd.h>
@@ -36,6 +37,26 @@
 
 	static unsigned int	comm_failures = 0;
 
+/* asynchronous transport */
+typedef struct async_req_s {
+	ser_request_t	req;
+	struct async_req_s	*next;
+} async_req_t;
+
+	static int	async_fd = -1;
+	static async_req_t	*async_head = NULL, *async_tail = NULL;
+	static size_t	async_sent = 0;		/* bytes of the head command sent */
+	static int	async_waiting = 0;	/* head command sent, waiting for the reply */
+	static struct timeval	async_timer;	/* next char to send, or end of the reply timeout */
+	static double	async_start;	/* head command send time, for perf_io() */
+	static char	async_buf[LARGEBUF];
+	static size_t	async_len = 0;
+	static int	async_running = 0;
+	static const char	*async_alertset = "";
+	static void	(*async_alert)(char ch) = NULL;
+
+	static void async_run(void);
+
 static void ser_open_error(const char *port)
 {
 	struct	stat	fs;
@@ -242,6 +263,12 @@ int ser_flush_io(int fd)
 
 int ser_close(int fd, const char *port)
 {
+	if ((fd != -1) && (fd == async_fd)) {
+		ser_async_flush();
+		dstate_set_io(-1, NULL, NULL);
+		async_fd = -1;
+	}
+
 	if (fd < 0)
 		fatal_with_errno(EXIT_FAILURE, "ser_close: programming error: fd=%d port=%s", fd, port);
 
@@ -335,19 +362,34 @@ int ser_send_buf_pace(int fd, unsigned long d_usec, const void *buf,
 
 int ser_get_char(int fd, void *ch, long d_sec, long d_usec)
 {
-	return select_read(fd, ch, 1, d_sec, d_usec);
+	double	start = monotime();
+	int	ret;
+
+	ret = select_read(fd, ch, 1, d_sec, d_usec);
+
+	perf_io(start);
+
+	return ret;
 }
 
 int ser_get_buf(int fd, void *buf, size_t buflen, long d_sec, long d_usec)
 {
+	double	start = monotime();
+	int	ret;
+
 	memset(buf, '\0', buflen);
 
-	return select_read(fd, buf, buflen, d_sec, d_usec);
+	ret = select_read(fd, buf, buflen, d_sec, d_usec);
+
+	perf_io(start);
+
+	return ret;
 }
 
 /* keep reading until buflen bytes are received or a timeout occurs */
 int ser_get_buf_len(int fd, void *buf, size_t buflen, long d_sec, long d_usec)
 {
+	double	start = monotime();
 	int	ret;
 	size_t	recv;
 	char	*data = buf;
@@ -359,10 +401,13 @@ int ser_get_buf_len(int fd, void *buf, size_t buflen, long d_sec, long d_usec)
 		ret = select_read(fd, &data[recv], buflen - recv, d_sec, d_usec);
 
 		if (ret < 1) {
+			perf_io(start);
 			return ret;
 		}
 	}
 
+	perf_io(start);
+
 	return recv;
 }
 
@@ -372,6 +417,7 @@ int ser_get_line_alert(int fd, void *buf, size_t buflen, char endchar,
 	const char *ignset, const char *alertset, void handler(char ch), 
 	long d_sec, long d_usec)
 {
+	double	start = monotime();
 	int	i, ret;
 	char	tmp[64];
 	char	*data = buf;
@@ -385,12 +431,14 @@ int ser_get_line_alert(int fd, void *buf, size_t buflen, char endchar,
 		ret = select_read(fd, tmp, sizeof(tmp), d_sec, d_usec);
 
 		if (ret < 1) {
+			perf_io(start);
 			return ret;
 		}
 
 		for (i = 0; i < ret; i++) {
 
 			if ((count == maxcount) || (tmp[i] == endchar)) {
+				perf_io(start);
 				return count;
 			}
 
@@ -408,6 +456,8 @@ int ser_get_line_alert(int fd, void *buf, size_t buflen, char endchar,
 		}
 	}
 
+	perf_io(start);
+
 	return count;
 }
 
@@ -424,7 +474,7 @@ int ser_flush_in(int fd, const char *ignset, int verbose)
 	int	ret, extra = 0;
 	char	ch;
 
-	while ((ret = ser_get_char(fd, &ch, 0, 0)) > 0) {
+	while ((ret = select_read(fd, &ch, 1, 0, 0)) > 0) {
 
 		if (strchr(ignset, ch))
 			continue;
@@ -443,6 +493,253 @@ int ser_flush_in(int fd, const char *ignset, int verbose)
 	return extra;
 }
 
+static void async_timer_set(long d_sec, long d_usec)
+{
+	gettimeofday(&async_timer, NULL);
+
+	async_timer.tv_sec += d_sec + (async_timer.tv_usec + d_usec) / 1000000;
+	async_timer.tv_usec = (async_timer.tv_usec + d_usec) % 1000000;
+}
+
+static int async_timer_expired(void)
+{
+	struct timeval	now;
+
+	gettimeofday(&now, NULL);
+
+	if (now.tv_sec != async_timer.tv_sec) {
+		return (now.tv_sec > async_timer.tv_sec);
+	}
+
+	return (now.tv_usec >= async_timer.tv_usec);
+}
+
+/* complete the request at the head of the queue */
+static void async_done(int ret)
+{
+	async_req_t	*ar = async_head;
+
+	async_head = ar->next;
+
+	if (!async_head) {
+		async_tail = NULL;
+	}
+
+	/* no reply to a request that failed, or was never sent */
+	if ((ret < 0) || !async_waiting) {
+		async_buf[0] = '\0';
+	} else {
+		perf_io(async_start);
+	}
+
+	async_sent = 0;
+	async_waiting = 0;
+	async_len = 0;
+
+	/* the reply may queue the next request */
+	if (ar->req.reply) {
+		ar->req.reply(ret, async_buf, ar->req.arg);
+	}
+
+	free((char *)ar->req.cmd);
+	free(ar);
+}
+
+/* add a received char to the reply, return 1 once it is complete */
+static int async_collect(char ch)
+{
+	ser_request_t	*req = &async_head->req;
+	size_t	len;
+
+	if (!req->frame && (ch == req->endchar)) {
+		async_buf[async_len] = '\0';
+		async_done(async_len);
+		return 1;
+	}
+
+	if (req->ignset && strchr(req->ignset, ch)) {
+		return 0;
+	}
+
+	async_buf[async_len++] = ch;
+	async_buf[async_len] = '\0';
+
+	if (req->frame) {
+		len = req->frame(async_buf, async_len, req->arg);
+
+		if (len > 0) {
+			async_buf[len] = '\0';
+			async_done(len);
+			return 1;
+		}
+	}
+
+	/* like ser_get_line(), return what fits in the buffer */
+	if (async_len == sizeof(async_buf) - 1) {
+		async_done(async_len);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void async_receive(void)
+{
+	int	i, ret;
+	char	tmp[64];
+
+	while ((ret = select_read(async_fd, tmp, sizeof(tmp), 0, 0)) > 0) {
+
+		for (i = 0; i < ret; i++) {
+
+			if ((tmp[i] != '\0') && strchr(async_alertset, tmp[i])) {
+				if (async_alert) {
+					async_alert(tmp[i]);
+				}
+				continue;
+			}
+
+			/* nothing asked: stale or unsolicited data */
+			if (!async_head || !async_waiting) {
+				upsdebugx(4, "%s: discarding 0x%02x", __func__, tmp[i] & 0xFF);
+				continue;
+			}
+
+			async_collect(tmp[i]);
+		}
+	}
+
+	if ((ret < 0) && async_head && async_waiting) {
+		upsdebug_with_errno(3, "%s: read failed", __func__);
+		async_done(-1);
+	}
+}
+
+/* send the head command, return 0 when nothing more can be done now */
+static int async_send(void)
+{
+	ser_request_t	*req = &async_head->req;
+	int	ret;
+
+	if (async_sent > 0 && !async_timer_expired()) {
+		return 0;	/* still pacing */
+	}
+
+	if (async_sent == 0) {
+		async_start = monotime();
+	}
+
+	if (req->pace == 0) {
+		ret = ser_send_buf(async_fd, req->cmd, req->cmdlen);
+	} else {
+		ret = ser_send_buf(async_fd, &req->cmd[async_sent], 1);
+	}
+
+	if (ret < 1) {
+		upsdebug_with_errno(3, "%s: write failed", __func__);
+		async_done(-1);
+		return 1;
+	}
+
+	async_sent += ret;
+
+	if (async_sent < req->cmdlen) {
+		async_timer_set(0, req->pace);
+		return 0;
+	}
+
+	async_waiting = 1;
+	async_timer_set(req->d_sec, req->d_usec);
+
+	async_buf[0] = '\0';
+
+	return 0;
+}
+
+/* dstate_poll_fds() handler: receive, check timeouts and send */
+static void async_run(void)
+{
+	async_running = 1;
+
+	async_receive();
+
+	if (async_head && async_waiting && async_timer_expired()) {
+		upsdebugx(3, "%s: reply timeout", __func__);
+		async_done(0);
+	}
+
+	while (async_head && !async_waiting && async_send())
+		;
+
+	dstate_set_io(async_fd, async_head ? &async_timer : NULL, async_run);
+
+	async_running = 0;
+}
+
+void ser_async_init(int fd, const char *alertset, void handler(char ch))
+{
+	async_fd = fd;
+	async_alertset = alertset ? alertset : "";
+	async_alert = handler;
+
+	dstate_set_io(async_fd, NULL, async_run);
+}
+
+int ser_async_queue(const ser_request_t *req)
+{
+	async_req_t	*ar;
+	char	*cmd;
+
+	if ((async_fd == -1) || (req->cmdlen < 1)) {
+		return -1;
+	}
+
+	ar = xcalloc(1, sizeof(*ar));
+	ar->req = *req;
+
+	cmd = xmalloc(req->cmdlen);
+	memcpy(cmd, req->cmd, req->cmdlen);
+	ar->req.cmd = cmd;
+
+	if (async_tail) {
+		async_tail->next = ar;
+	} else {
+		async_head = ar;
+	}
+
+	async_tail = ar;
+
+	/* start right away if the line is idle (when not called from a reply) */
+	if ((async_head == ar) && !async_running) {
+		async_run();
+	}
+
+	return 0;
+}
+
+int ser_async_pending(void)
+{
+	async_req_t	*ar;
+	int	count = 0;
+
+	for (ar = async_head; ar; ar = ar->next) {
+		count++;
+	}
+
+	return count;
+}
+
+void ser_async_flush(void)
+{
+	while (async_head) {
+		async_done(-1);
+	}
+
+	if (async_fd != -1) {
+		dstate_set_io(async_fd, NULL, async_run);
+	}
+}
+
 void ser_comm_fail(const char *fmt, ...)
 {
 	int	ret;
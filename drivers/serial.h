@@ -70,6 +70,39 @@ int ser_get_line(int fd, void *buf, size_t buflen, char endchar,
 
 int ser_flush_in(int fd, const char *ignset, int verbose);
 
+/* asynchronous transport: the requests are queued, sent in order and their
+   replies are collected from dstate_poll_fds(), so the driver does not
+   block while waiting for the UPS */
+typedef struct {
+	const char	*cmd;		/* bytes to send */
+	size_t	cmdlen;
+	unsigned long	pace;		/* d_usec delay after each char */
+	char	endchar;		/* end of the reply if frame is NULL */
+	const char	*ignset;	/* chars not stored in the reply */
+
+	/* length of the complete reply at the start of buf, or 0 */
+	size_t	(*frame)(const char *buf, size_t len, void *arg);
+
+	/* called with the reply length, 0 on timeout and -1 on failure */
+	void	(*reply)(int ret, const char *buf, void *arg);
+	void	*arg;
+
+	long	d_sec;			/* reply timeout */
+	long	d_usec;
+} ser_request_t;
+
+/* start the transport on fd, alerts may be received at any time */
+void ser_async_init(int fd, const char *alertset, void handler(char ch));
+
+/* copy the request at the end of the queue */
+int ser_async_queue(const ser_request_t *req);
+
+/* number of requests not completed yet */
+int ser_async_pending(void);
+
+/* drop the queued requests (their reply is called with -1) */
+void ser_async_flush(void);
+
 /* unified failure reporting: call these often */
 void ser_comm_fail(const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 1, 2)));
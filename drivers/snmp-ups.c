@@ -478,6 +478,7 @@ struct snmp_pdu *nut_snmp_get(const char *OID)
 	oid name[MAX_OID_LEN];
 	size_t name_len = MAX_OID_LEN;
 	static unsigned int numerr = 0;
+	double start;
 
 	upsdebugx(3, "nut_snmp_get(%s)", OID);
 
@@ -495,7 +496,9 @@ struct snmp_pdu *nut_snmp_get(const char *OID)
 
 	snmp_add_null_var(pdu, name, name_len);
 
+	start = monotime();
 	status = snmp_synch_response(g_snmp_sess_p, pdu, &response);
+	perf_io(start);
 
 	if (!response)
 		return NULL;
@@ -635,6 +638,7 @@ bool_t nut_snmp_set(const char *OID, char type, const char *value)
 	struct snmp_pdu *pdu, *response = NULL;
 	oid name[MAX_OID_LEN];
 	size_t name_len = MAX_OID_LEN;
+	double start;
 
 	upsdebugx(1, "entering nut_snmp_set (%s, %c, %s)", OID, type, value);
 
@@ -655,7 +659,9 @@ bool_t nut_snmp_set(const char *OID, char type, const char *value)
 		return FALSE;
 	}
 
+	start = monotime();
 	status = snmp_synch_response(g_snmp_sess_p, pdu, &response);
+	perf_io(start);
 
 	if ((status == STAT_SUCCESS) && (response->errstat == SNMP_ERR_NOERROR))
 		ret = TRUE;
@@ -259,6 +259,10 @@ static int reconnect_ups(void)
 	upsdebugx(2, "==================================================");
 
 	ret = comm_driver->open(&udev, &curDevice, reopen_matcher, NULL);
+
+	usb_reconnect_done(ret > 0);
+	extrafd = usb_reconnect_fd();
+
 	if (ret < 1) {
 		upslogx(LOG_INFO, "Reconnecting to UPS failed; will retry later...");
 		dstate_datastale();
@@ -430,8 +434,14 @@ void usb_comm_fail(int res, const char *msg)
 		default:
 			upslogx(LOG_WARNING, "%s: Device detached? (error %d: %s)", msg, res, usb_strerror());
 
-			upslogx(LOG_NOTICE, "Reconnect attempt #%d", ++try);
+			/* scan the bus on hotplug, or with a growing delay */
 			hd = NULL;
+			if (!usb_reconnect_due()) {
+				dstate_datastale();
+				break;
+			}
+
+			upslogx(LOG_NOTICE, "Reconnect attempt #%d", ++try);
 			reconnect_ups();
 
 			if(hd) {
@@ -168,13 +168,17 @@ static void debugcmdline(int level, const char *msg, char *const argv[])
 {
 	char	cmdline[LARGEBUF];
 
+	if (nut_debug_level < level)
+		return;
+
 	snprintf(cmdline, sizeof(cmdline), "%s", msg);
 
 	while (*argv) {
 		snprintfcat(cmdline, sizeof(cmdline), " %s", *argv++);
 	}
 
-	upsdebugx(level, "%s", cmdline);
+	/* one line per driver started, not worth a rate limit slot */
+	upslogx(LOG_DEBUG, "%s", cmdline);
 }
 
 static void forkexec(char *const argv[], const ups_t *ups)
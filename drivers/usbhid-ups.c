@@ -35,6 +35,13 @@
 #include "hidparser.h"
 #include "hidtypes.h"
 
+/* read the interrupt pipe continuously (not for SHUT, which shares
+   the serial line between interrupt and control transfers) */
+#if defined(HAVE_PTHREAD) && !defined(SHUT_MODE)
+	#define HU_EVENT_THREAD
+	#include <pthread.h>
+#endif
+
 /* include all known subdrivers */
 #include "mge-hid.h"
 
@@ -112,11 +119,44 @@ bool_t use_interrupt_pipe = TRUE;
 bool_t use_interrupt_pipe = FALSE;
 #endif
 static time_t lastpoll; /* Timestamp the last polling */
+static time_t lastwalk; /* Timestamp the last (quick or full) update */
 hid_dev_handle_t udev;
 
+/* lookup tables for find_nut_info() and find_hid_info() */
+static hid_info_t **nut_lookup = NULL;
+static hid_info_t **hid_lookup = NULL;
+static size_t lookup_mask = 0;
+
+/* reports polled by the quick and full updates (the semi static data
+   being polled by the latter only after changes), and the ones that
+   were read successfully by the current update */
+typedef struct {
+	int		count;
+	unsigned char	id[256];
+} report_plan_t;
+
+static report_plan_t quick_plan, full_plan, semistatic_plan;
+static bool_t plan_ready = FALSE;
+static bool_t report_ok[256];
+
+/* cache of the parsed report descriptor and of the NUT-to-HID mapping
+   (the pDesc item index of each hid2nut entry, or -1), in the state path */
+#define HU_CACHE_VERSION	1
+
+static char cache_fn[SMALLBUF];
+static char cache_subdriver[SMALLBUF];
+static uint32_t rdhash = 0;
+static int rdsize = 0;
+static int *item_map = NULL;
+static int item_count = 0;
+static bool_t mapping_cached = FALSE;
+
 /* support functions */
 static hid_info_t *find_nut_info(const char *varname);
 static hid_info_t *find_hid_info(const HIDData_t *hiddata);
+static void build_lookup_tables(void);
+static void build_report_plans(void);
+static bool_t fetch_reports(walkmode_t mode);
 static const char *hu_find_infoval(info_lkp_t *hid2info, const double value);
 static long hu_find_valinfo(info_lkp_t *hid2info, const char* value);
 static void process_boolean_info(const char *nutvalue);
@@ -126,6 +166,9 @@ static bool_t hid_ups_walk(walkmode_t mode);
 static int reconnect_ups(void);
 static int ups_infoval_set(hid_info_t *item, double value);
 static int callback(hid_dev_handle_t udev, HIDDevice_t *hd, unsigned char *rdbuf, int rdlen);
+static HIDDesc_t *load_desc_cache(HIDDevice_t *hd, unsigned char *rdbuf, int rdlen);
+static void save_desc_cache(void);
+static HIDData_t *cached_item_data(hid_info_t *item);
 #ifdef DEBUG
 static double interval(void);
 #endif
@@ -752,6 +795,128 @@ void upsdrv_makevartable(void)
 
 #define	MAX_EVENT_NUM	32
 
+#ifdef HU_EVENT_THREAD
+/* Interrupt pipe reader: reports are read as soon as the UPS sends them,
+ * and queued in a pipe that wakes up dstate_poll_fds() through extrafd.
+ * Only this thread uses the interrupt endpoint, all the control transfers
+ * (and the report parsing) are still done by the main loop. */
+static pthread_t	evthread;
+static int	evpipe[2] = { -1, -1 };
+static volatile int	evthread_stop = 0;
+
+static void *interrupt_reader(void *arg)
+{
+	unsigned char	buf[sizeof(int) + SMALLBUF];
+	int	len;
+
+	while (!evthread_stop) {
+
+		len = comm_driver->get_interrupt(udev, &buf[sizeof(int)], SMALLBUF, 250);
+
+		if (len == 0) {
+			continue;	/* no event */
+		}
+
+		/* on errors, stop and let the main loop find out what happened */
+		if (len < 0) {
+			len = 0;
+		}
+
+		memcpy(buf, &len, sizeof(int));
+
+		if (write(evpipe[1], buf, sizeof(int) + len) < 0) {
+			upsdebug_with_errno(1, "%s: report dropped", __func__);
+		}
+
+		if (len == 0) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void interrupt_reader_start(void)
+{
+	if (evpipe[0] != -1) {
+		return;	/* already running */
+	}
+
+	if (pipe(evpipe)) {
+		upslog_with_errno(LOG_ERR, "%s: pipe", __func__);
+		evpipe[0] = evpipe[1] = -1;
+		return;
+	}
+
+	fcntl(evpipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(evpipe[1], F_SETFL, O_NONBLOCK);
+
+	evthread_stop = 0;
+
+	if (pthread_create(&evthread, NULL, interrupt_reader, NULL)) {
+		upslogx(LOG_ERR, "%s: can't create thread, polling the interrupt pipe", __func__);
+		close(evpipe[0]);
+		close(evpipe[1]);
+		evpipe[0] = evpipe[1] = -1;
+		return;
+	}
+
+	extrafd = evpipe[0];
+
+	upsdebugx(1, "Interrupt pipe reader started");
+}
+
+static void interrupt_reader_stop(void)
+{
+	if (evpipe[0] == -1) {
+		return;
+	}
+
+	evthread_stop = 1;
+	pthread_join(evthread, NULL);
+
+	close(evpipe[0]);
+	close(evpipe[1]);
+	evpipe[0] = evpipe[1] = -1;
+
+	extrafd = -1;
+
+	upsdebugx(1, "Interrupt pipe reader stopped");
+}
+
+/* parse the reports queued by the reader */
+static int interrupt_reader_events(HIDData_t **event, int eventsize)
+{
+	unsigned char	buf[SMALLBUF];
+	int	len, ret, evtCount = 0;
+
+	if (evpipe[0] == -1) {
+		return HIDGetEvents(udev, event, eventsize);
+	}
+
+	while (read(evpipe[0], &len, sizeof(len)) == sizeof(len)) {
+
+		if (len == 0) {
+			/* the reader gave up, the update will tell why */
+			interrupt_reader_stop();
+			break;
+		}
+
+		if (read(evpipe[0], buf, len) != len) {
+			break;
+		}
+
+		ret = HIDParseEvents(buf, len, &event[evtCount], eventsize - evtCount);
+
+		if (ret > 0) {
+			evtCount += ret;
+		}
+	}
+
+	return evtCount;
+}
+#endif /* HU_EVENT_THREAD */
+
 void upsdrv_updateinfo(void)
 {
 	hid_info_t	*item;
@@ -766,6 +931,29 @@ void upsdrv_updateinfo(void)
 
 	/* check for device availability to set datastale! */
 	if (hd == NULL) {
+#ifdef HU_EVENT_THREAD
+		/* the reader must not use the handle while reconnecting */
+		interrupt_reader_stop();
+#endif
+#ifndef SHUT_MODE
+		/* scan the bus on hotplug, or with a growing delay */
+		if (!usb_reconnect_due()) {
+			return;
+		}
+
+		upsdebugx(1, "Got to reconnect!\n");
+
+		if (!reconnect_ups()) {
+			usb_reconnect_done(0);
+			extrafd = usb_reconnect_fd();
+			lastpoll = now;
+			dstate_datastale();
+			return;
+		}
+
+		usb_reconnect_done(1);
+		extrafd = -1;
+#else
 		/* don't flood reconnection attempts */
 		if (now < (int)(lastpoll + poll_interval)) {
 			return;
@@ -778,6 +966,7 @@ void upsdrv_updateinfo(void)
 			dstate_datastale();
 			return;
 		}
+#endif
 
 		hd = &curDevice;
 
@@ -791,7 +980,12 @@ void upsdrv_updateinfo(void)
 #endif
 	/* Get HID notifications on Interrupt pipe first */
 	if (use_interrupt_pipe == TRUE) {
+#ifdef HU_EVENT_THREAD
+		interrupt_reader_start();
+		evtCount = interrupt_reader_events(event, MAX_EVENT_NUM);
+#else
 		evtCount = HIDGetEvents(udev, event, MAX_EVENT_NUM);
+#endif
 		upsdebugx(1, "Got %i HID objects...", (evtCount >= 0) ? evtCount : 0);
 	} else {
 		evtCount = 0;
@@ -826,6 +1020,14 @@ void upsdrv_updateinfo(void)
 	/* clear status buffer before begining */
 	status_init();
 
+#ifdef HU_EVENT_THREAD
+	/* woken up by the interrupt pipe reader, between two updates */
+	if ((evtCount > 0) && (extrafd != -1) && (now < lastwalk + poll_interval)) {
+		ups_status_set();
+		status_commit();
+		return;
+	}
+#endif
 	/* Do a full update (polling) every pollfreq or upon data change (ie setvar/instcmd) */
 	if ((now > (lastpoll + pollfreq)) || (data_has_changed == TRUE)) {
 		upsdebugx(1, "Full update...");
@@ -836,6 +1038,7 @@ void upsdrv_updateinfo(void)
 			return;
 
 		lastpoll = now;
+		lastwalk = now;
 		data_has_changed = FALSE;
 
 		ups_alarm_set();
@@ -846,6 +1049,8 @@ void upsdrv_updateinfo(void)
 		/* Quick poll data only to see if the UPS is still connected */
 		if (hid_ups_walk(HU_WALKMODE_QUICK_UPDATE) == FALSE)
 			return;
+
+		lastwalk = now;
 	}
 
 	ups_status_set();
@@ -997,8 +1202,14 @@ void upsdrv_cleanup(void)
 {
 	upsdebugx(1, "upsdrv_cleanup...");
 
+#ifdef HU_EVENT_THREAD
+	interrupt_reader_stop();
+#endif
 	comm_driver->close(udev);
 	Free_ReportDesc(pDesc);
+	free(item_map);
+	free(nut_lookup);
+	free(hid_lookup);
 	free_report_buffer(reportbuf);
 #ifndef SHUT_MODE
 	USBFreeExactMatcher(exact_matcher);
@@ -1067,9 +1278,12 @@ static int callback(hid_dev_handle_t udev, HIDDevice_t *hd, unsigned char *rdbuf
 	upsdebugx(2, "Report Descriptor size = %d", rdlen);
 	upsdebug_hex(3, "Report Descriptor", rdbuf, rdlen);
 
-	/* Parse Report Descriptor */
+	/* Parse Report Descriptor (unless it is in the cache) */
 	Free_ReportDesc(pDesc);
-	pDesc = Parse_ReportDesc(rdbuf, rdlen);
+	pDesc = load_desc_cache(hd, rdbuf, rdlen);
+	if (!pDesc) {
+		pDesc = Parse_ReportDesc(rdbuf, rdlen);
+	}
 	if (!pDesc) {
 		upsdebug_with_errno(1, "Failed to parse report descriptor!");
 		return 0;
@@ -1099,6 +1313,20 @@ static int callback(hid_dev_handle_t udev, HIDDevice_t *hd, unsigned char *rdbuf
 
 	upslogx(2, "Using subdriver: %s", subdriver->name);
 
+	/* the cached mapping is only good for the same subdriver */
+	for (i = 0; subdriver->hid2nut[i].info_type != NULL; i++);
+
+	if ((mapping_cached == TRUE) && (strcmp(cache_subdriver, subdriver->name) || (item_count != i))) {
+		upsdebugx(2, "Cached mapping is for subdriver %s, not using it", cache_subdriver);
+		mapping_cached = FALSE;
+	}
+
+	if (mapping_cached == FALSE) {
+		item_count = i;
+		free(item_map);
+		item_map = xcalloc(item_count, sizeof(*item_map));
+	}
+
 	HIDDumpTree(udev, subdriver->utab);
 
 #ifndef SHUT_MODE
@@ -1167,6 +1395,12 @@ static bool_t hid_ups_walk(walkmode_t mode)
 
 	/* 3 modes: HU_WALKMODE_INIT, HU_WALKMODE_QUICK_UPDATE and HU_WALKMODE_FULL_UPDATE */
 
+	/* Read the needed reports first, once each */
+	if ((mode != HU_WALKMODE_INIT) && (plan_ready == TRUE)) {
+		if (fetch_reports(mode) == FALSE)
+			return FALSE;
+	}
+
 	/* Device data walk ----------------------------- */
 	for (item = subdriver->hid2nut; item->info_type != NULL; item++) {
 
@@ -1188,7 +1422,13 @@ static bool_t hid_ups_walk(walkmode_t mode)
 				break;
 
 			/* Create the NUT-to-HID mapping */
-			item->hiddata = HIDGetItemData(item->hidpath, subdriver->utab);
+			if (mapping_cached == TRUE) {
+				item->hiddata = cached_item_data(item);
+			} else {
+				item->hiddata = HIDGetItemData(item->hidpath, subdriver->utab);
+				item_map[item - subdriver->hid2nut] = item->hiddata ? item->hiddata - pDesc->item : -1;
+			}
+
 			if (item->hiddata == NULL)
 				continue;
 
@@ -1245,6 +1485,14 @@ static bool_t hid_ups_walk(walkmode_t mode)
 			fatalx(EXIT_FAILURE, "hid_ups_walk: unknown update mode!");
 		}
 
+		/* Not in this device's report descriptor */
+		if (item->hiddata == NULL)
+			continue;
+
+		/* This report couldn't be read, don't try again for each item */
+		if ((mode != HU_WALKMODE_INIT) && (plan_ready == TRUE) && (report_ok[item->hiddata->ReportID] == FALSE))
+			continue;
+
 		retcode = HIDGetDataValue(udev, item->hiddata, &value, poll_interval);
 
 		switch (retcode)
@@ -1316,9 +1564,172 @@ static bool_t hid_ups_walk(walkmode_t mode)
 		}
 	}
 
+	/* the NUT-to-HID mapping is known now */
+	if (mode == HU_WALKMODE_INIT) {
+		build_lookup_tables();
+		build_report_plans();
+
+		if (mapping_cached == FALSE) {
+			save_desc_cache();
+			mapping_cached = TRUE;
+		}
+	}
+
 	return TRUE;
 }
 
+/* hash of the report descriptor (FNV-1a) */
+static uint32_t desc_hash(const unsigned char *buf, int len)
+{
+	uint32_t	hash = 2166136261U;
+	int	i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= buf[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* Load the parsed report descriptor for this device, if it was cached
+ * for the same report descriptor. The cached NUT-to-HID mapping is loaded
+ * as well, and later checked against the subdriver in callback().
+ * Return NULL if the descriptor must be parsed.
+ */
+static HIDDesc_t *load_desc_cache(HIDDevice_t *hd, unsigned char *rdbuf, int rdlen)
+{
+	FILE		*fp;
+	HIDDesc_t	*desc;
+	char		buf[SMALLBUF], vers[SMALLBUF], *ptr;
+	const char	*sp;
+	int		version, datasize, len, i;
+	unsigned int	hash;
+
+	mapping_cached = FALSE;
+
+	rdhash = desc_hash(rdbuf, rdlen);
+	rdsize = rdlen;
+
+	/* keyed by VID/PID/serial, with only safe characters for a filename */
+	snprintf(cache_fn, sizeof(cache_fn), "%s/usbhid-ups-%04x-%04x-", dflt_statepath(),
+		hd->VendorID, hd->ProductID);
+
+	for (sp = hd->Serial ? hd->Serial : "noserial"; *sp; sp++) {
+		snprintfcat(cache_fn, sizeof(cache_fn), "%c", isalnum((unsigned char)*sp) ? *sp : '_');
+	}
+
+	snprintfcat(cache_fn, sizeof(cache_fn), ".cache");
+
+	fp = fopen(cache_fn, "rb");
+	if (!fp) {
+		upsdebug_with_errno(2, "No report descriptor cache (%s)", cache_fn);
+		return NULL;
+	}
+
+	desc = calloc(1, sizeof(*desc));
+
+	if ((!desc) || (!fgets(buf, sizeof(buf), fp))
+		|| (sscanf(buf, "usbhid-ups-cache %d %511s %d %d %x", &version, vers, &datasize, &len, &hash) != 5)
+		|| (version != HU_CACHE_VERSION) || strcmp(vers, UPS_VERSION) || (datasize != (int)sizeof(HIDData_t))
+		|| (len != rdlen) || (hash != rdhash)) {
+		upsdebugx(2, "Report descriptor cache is out of date (%s)", cache_fn);
+		goto fail;
+	}
+
+	if (!fgets(cache_subdriver, sizeof(cache_subdriver), fp)) {
+		goto fail;
+	}
+
+	ptr = strchr(cache_subdriver, '\n');
+	if (ptr) {
+		*ptr = '\0';
+	}
+
+	if ((fread(&desc->nitems, sizeof(desc->nitems), 1, fp) != 1)
+		|| (desc->nitems < 1) || (desc->nitems > MAX_REPORT)
+		|| (fread(desc->replen, sizeof(desc->replen), 1, fp) != 1)) {
+		goto fail;
+	}
+
+	desc->item = calloc(desc->nitems, sizeof(*desc->item));
+
+	if ((!desc->item) || (fread(desc->item, sizeof(*desc->item), desc->nitems, fp) != (size_t)desc->nitems)
+		|| (fread(&item_count, sizeof(item_count), 1, fp) != 1) || (item_count < 1)) {
+		goto fail;
+	}
+
+	free(item_map);
+	item_map = xcalloc(item_count, sizeof(*item_map));
+
+	if (fread(item_map, sizeof(*item_map), item_count, fp) != (size_t)item_count) {
+		goto fail;
+	}
+
+	for (i = 0; i < item_count; i++) {
+		if ((item_map[i] < -1) || (item_map[i] >= desc->nitems)) {
+			goto fail;
+		}
+	}
+
+	fclose(fp);
+
+	upsdebugx(2, "Using cached report descriptor (%s)", cache_fn);
+
+	mapping_cached = TRUE;
+	return desc;
+
+fail:
+	upsdebugx(2, "Not using report descriptor cache");
+	fclose(fp);
+	Free_ReportDesc(desc);
+	return NULL;
+}
+
+/* save the parsed report descriptor and the mapping of the INIT walk */
+static void save_desc_cache(void)
+{
+	FILE	*fp;
+	char	tmpfn[SMALLBUF + 16];
+
+	if (!cache_fn[0]) {
+		return;
+	}
+
+	snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", cache_fn, (long)getpid());
+
+	fp = fopen(tmpfn, "wb");
+	if (!fp) {
+		upsdebug_with_errno(2, "Can't write report descriptor cache (%s)", tmpfn);
+		return;
+	}
+
+	fprintf(fp, "usbhid-ups-cache %d %s %d %d %08x\n", HU_CACHE_VERSION, UPS_VERSION,
+		(int)sizeof(HIDData_t), rdsize, (unsigned int)rdhash);
+	fprintf(fp, "%s\n", subdriver->name);
+
+	fwrite(&pDesc->nitems, sizeof(pDesc->nitems), 1, fp);
+	fwrite(pDesc->replen, sizeof(pDesc->replen), 1, fp);
+	fwrite(pDesc->item, sizeof(*pDesc->item), pDesc->nitems, fp);
+	fwrite(&item_count, sizeof(item_count), 1, fp);
+	fwrite(item_map, sizeof(*item_map), item_count, fp);
+
+	if ((fclose(fp) != 0) || (rename(tmpfn, cache_fn) != 0)) {
+		upsdebug_with_errno(2, "Can't write report descriptor cache (%s)", cache_fn);
+		unlink(tmpfn);
+		return;
+	}
+
+	upsdebugx(2, "Report descriptor cache saved (%s)", cache_fn);
+}
+
+static HIDData_t *cached_item_data(hid_info_t *item)
+{
+	int	idx = item_map[item - subdriver->hid2nut];
+
+	return (idx < 0) ? NULL : &pDesc->item[idx];
+}
+
 static int reconnect_ups(void)
 {
 	int ret;
@@ -1429,12 +1840,198 @@ static void ups_status_set(void)
 	}
 }
 
+/* Lookup tables for find_nut_info() and find_hid_info(), indexed by
+ * hashed NUT varname and HID data pointer (open addressing, linear
+ * probing), see the globals. They are built after the HU_WALKMODE_INIT
+ * walk, until then the info array is searched linearly.
+ */
+static size_t hash_nut_info(const char *varname)
+{
+	size_t	hash = 5381;
+
+	/* case insensitive, like the strcasecmp() match */
+	while (*varname) {
+		hash = (hash * 33) + tolower((unsigned char)*varname++);
+	}
+
+	return hash & lookup_mask;
+}
+
+static size_t hash_hid_info(const HIDData_t *hiddata)
+{
+	/* HID data are items of the pDesc array */
+	return ((size_t)hiddata / sizeof(*hiddata)) & lookup_mask;
+}
+
+static void build_lookup_tables(void)
+{
+	hid_info_t	*item;
+	size_t		count = 0, i;
+
+	for (item = subdriver->hid2nut; item->info_type != NULL; item++) {
+		count++;
+	}
+
+	/* keep the tables at most half full */
+	for (lookup_mask = 15; lookup_mask < 2 * count; lookup_mask = (lookup_mask << 1) | 1);
+
+	free(nut_lookup);
+	free(hid_lookup);
+
+	nut_lookup = xcalloc(lookup_mask + 1, sizeof(*nut_lookup));
+	hid_lookup = xcalloc(lookup_mask + 1, sizeof(*hid_lookup));
+
+	/* on duplicates, the first item wins (as with a linear search) */
+	for (item = subdriver->hid2nut; item->info_type != NULL; item++) {
+
+		if (item->hiddata == NULL)
+			continue;
+
+		for (i = hash_nut_info(item->info_type); nut_lookup[i] != NULL; i = (i + 1) & lookup_mask) {
+			if (!strcasecmp(nut_lookup[i]->info_type, item->info_type))
+				break;
+		}
+
+		if (nut_lookup[i] == NULL)
+			nut_lookup[i] = item;
+
+		/* Skip server side vars */
+		if (item->hidflags & HU_FLAG_ABSENT)
+			continue;
+
+		for (i = hash_hid_info(item->hiddata); hid_lookup[i] != NULL; i = (i + 1) & lookup_mask) {
+			if (hid_lookup[i]->hiddata == item->hiddata)
+				break;
+		}
+
+		if (hid_lookup[i] == NULL)
+			hid_lookup[i] = item;
+	}
+
+	upsdebugx(2, "%s: %d items, %d slots", __func__, (int)count, (int)(lookup_mask + 1));
+}
+
+static void add_report_plan(report_plan_t *plan, int id)
+{
+	int	i;
+
+	for (i = 0; i < plan->count; i++) {
+		if (plan->id[i] == id)
+			return;
+	}
+
+	plan->id[plan->count++] = id;
+}
+
+/* group the items polled by the updates by ReportID (same filters as
+ * in hid_ups_walk) */
+static void build_report_plans(void)
+{
+	hid_info_t	*item;
+
+	quick_plan.count = 0;
+	full_plan.count = 0;
+	semistatic_plan.count = 0;
+
+	for (item = subdriver->hid2nut; item->info_type != NULL; item++) {
+
+		if (item->hiddata == NULL)
+			continue;
+
+		if (item->hidflags & HU_FLAG_QUICK_POLL)
+			add_report_plan(&quick_plan, item->hiddata->ReportID);
+
+		if (item->hidflags & (HU_FLAG_ABSENT | HU_TYPE_CMD | HU_FLAG_STATIC))
+			continue;
+
+		if (item->hidflags & HU_FLAG_SEMI_STATIC)
+			add_report_plan(&semistatic_plan, item->hiddata->ReportID);
+		else
+			add_report_plan(&full_plan, item->hiddata->ReportID);
+	}
+
+	plan_ready = TRUE;
+
+	upsdebugx(2, "%s: %d reports for quick updates, %d (+%d semi static) for full updates",
+		__func__, quick_plan.count, full_plan.count, semistatic_plan.count);
+}
+
+static bool_t fetch_report_plan(const report_plan_t *plan)
+{
+	int	i, id, retcode;
+
+	for (i = 0; i < plan->count; i++) {
+
+		id = plan->id[i];
+
+		/* already read by this update */
+		if (report_ok[id] == TRUE)
+			continue;
+
+		retcode = HIDRefreshReport(udev, id, 0);
+
+		switch (retcode)
+		{
+		case -EBUSY:		/* Device or resource busy */
+			upslog_with_errno(LOG_CRIT, "Got disconnected by another driver");
+		case -EPERM:		/* Operation not permitted */
+		case -ENODEV:		/* No such device */
+		case -EACCES:		/* Permission denied */
+		case -EIO:		/* I/O error */
+		case -ENXIO:		/* No such device or address */
+		case -ENOENT:		/* No such file or directory */
+			/* Uh oh, got to reconnect! */
+			hd = NULL;
+			return FALSE;
+
+		case 1:
+			report_ok[id] = TRUE;
+			break;
+
+		default:
+			/* Don't know what happened, try again later... */
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+/* read each report needed by this update, so that the items can
+ * be decoded from the report buffer */
+static bool_t fetch_reports(walkmode_t mode)
+{
+	memset(report_ok, 0, sizeof(report_ok));
+
+	if (mode == HU_WALKMODE_QUICK_UPDATE)
+		return fetch_report_plan(&quick_plan);
+
+	if (fetch_report_plan(&full_plan) == FALSE)
+		return FALSE;
+
+	if (data_has_changed == FALSE)
+		return TRUE;
+
+	return fetch_report_plan(&semistatic_plan);
+}
+
 /* find info element definition in info array
  * by NUT varname.
  */
 static hid_info_t *find_nut_info(const char *varname)
 {
 	hid_info_t *hidups_item;
+	size_t	i;
+
+	if (nut_lookup != NULL) {
+		for (i = hash_nut_info(varname); nut_lookup[i] != NULL; i = (i + 1) & lookup_mask) {
+			if (!strcasecmp(nut_lookup[i]->info_type, varname))
+				return nut_lookup[i];
+		}
+
+		upsdebugx(2, "find_nut_info: unknown info type: %s", varname);
+		return NULL;
+	}
 
 	for (hidups_item = subdriver->hid2nut; hidups_item->info_type != NULL ; hidups_item++) {
 
@@ -1455,6 +2052,20 @@ static hid_info_t *find_nut_info(const char *varname)
 static hid_info_t *find_hid_info(const HIDData_t *hiddata)
 {
 	hid_info_t *hidups_item;
+	size_t	i;
+
+	if (hiddata == NULL) {
+		return NULL;
+	}
+
+	if (hid_lookup != NULL) {
+		for (i = hash_hid_info(hiddata); hid_lookup[i] != NULL; i = (i + 1) & lookup_mask) {
+			if (hid_lookup[i]->hiddata == hiddata)
+				return hid_lookup[i];
+		}
+
+		return NULL;
+	}
 
 	for (hidups_item = subdriver->hid2nut; hidups_item->info_type != NULL ; hidups_item++) {
 
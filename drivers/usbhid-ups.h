@@ -26,6 +26,7 @@
 #ifndef USBHID_UPS_H
 #define USBHID_UPS_H
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -94,6 +94,12 @@ const char * dflt_statepath(void);
 /* Return the alternate path for pid files */
 const char * altpidpath(void);
 
+/* time elapsed from an arbitrary point, that doesn't follow the changes of
+   the wall clock when the system has a monotonic one: in microseconds, and
+   in seconds for measurements */
+unsigned long long monotime_usec(void);
+double monotime(void);
+
 void upslog_with_errno(int priority, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
 void upslogx(int priority, const char *fmt, ...)
@@ -104,6 +110,10 @@ void upsdebugx(int level, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
 void upsdebug_hex(int level, const char *msg, const void *buf, int len);
 
+/* queue the log messages to a background thread from now on, for daemons
+   once they are done forking */
+void upslog_async(void);
+
 void fatal_with_errno(int status, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3))) __attribute__((noreturn));
 void fatalx(int status, const char *fmt, ...)
@@ -0,0 +1,98 @@
+/* trace.h - compact binary traces of device variables
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef TRACE_H_SEEN
+#define TRACE_H_SEEN 1
+
+#include "extstate.h"
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/* File layout, all integers are little endian:
+
+   header:	"NUTTRACE" (8 bytes), version (4 bytes), reserved (4 bytes)
+   records:	type (1), name length (1), value length (2),
+		microseconds since the previous record (4),
+		name, value (not terminated)
+
+   Longer pauses are stored as TRACE_WAIT records, without name or value. */
+
+#define TRACE_MAGIC	"NUTTRACE"
+#define TRACE_VERSION	1
+
+#define TRACE_HDR_LEN	16
+#define TRACE_REC_LEN	8
+
+#define TRACE_SETINFO	1
+#define TRACE_DELINFO	2
+#define TRACE_WAIT	3
+
+typedef struct {
+	const unsigned char	*data;	/* whole file, mapped or read */
+	size_t	size;
+	size_t	pos;		/* next record */
+	unsigned long long	usec;	/* time of the last record read */
+	int	mapped;
+} trace_t;
+
+typedef struct {
+	int	type;
+	unsigned long long	usec;	/* since the start of the trace */
+	char	var[SMALLBUF];
+	char	val[ST_MAX_VALUE_LEN];
+} trace_rec_t;
+
+typedef struct {
+	int	fd;
+	int	started;
+	unsigned long long	usec;	/* time of the last record written */
+	size_t	len;
+	unsigned char	buf[LARGEBUF];
+} trace_out_t;
+
+/* returns 0 on success, -1 with errno set otherwise */
+int trace_open(trace_t *trace, const char *fn);
+
+/* returns 1 with the next record in rec, 0 at the end, -1 if truncated */
+int trace_next(trace_t *trace, trace_rec_t *rec);
+
+void trace_rewind(trace_t *trace);
+void trace_close(trace_t *trace);
+
+/* open fn for appending, or create it with a header ("-" is stdout),
+   returns 0 on success, -1 with errno set otherwise */
+int trace_create(trace_out_t *out, const char *fn);
+
+/* queue a record, usec is on any monotonic clock, as only the differences
+   are stored; the first record after trace_create() has no delay */
+int trace_write(trace_out_t *out, int type, unsigned long long usec,
+	const char *var, const char *val);
+
+int trace_flush(trace_out_t *out);
+int trace_finish(trace_out_t *out);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+
+#endif	/* TRACE_H_SEEN */
@@ -23,6 +23,7 @@
 #include "sstate.h"
 #include "user.h"
 #include "netssl.h"
+#include "stats.h"
 
 	ups_t	*upstable = NULL;
 	int	num_ups = 0;
@@ -138,6 +139,13 @@ static int parse_upsd_conf_args(int numargs, char **arg)
 		return 1;
 	}
 
+	/* STATSFILE <file> */
+	if (!strcmp(arg[0], "STATSFILE")) {
+		free(statsfile);
+		statsfile = xstrdup(arg[1]);
+		return 1;
+	}
+
 	/* DATAPATH <dir> */
 	if (!strcmp(arg[0], "DATAPATH")) {
 		free(datapath);
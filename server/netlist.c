@@ -27,6 +27,7 @@
 #include "neterr.h"
 
 #include "netlist.h"
+#include "stats.h"
 
 extern	upstype_t	*firstups;	/* for list_ups */
 extern	nut_ctype_t *firstclient;	/* for list_clients */
@@ -285,6 +286,26 @@ static void list_clients(nut_ctype_t *client, const char *upsname)
 	sendback(client, "END LIST CLIENT %s\n", upsname);
 }
 
+static int stats_send(const char *name, const char *value, void *arg)
+{
+	char	esc[SMALLBUF];
+
+	pconf_encode(value, esc, sizeof(esc));
+
+	return sendback((nut_ctype_t *)arg, "STAT %s \"%s\"\n", name, esc);
+}
+
+static void list_stats(nut_ctype_t *client)
+{
+	if (!sendback(client, "BEGIN LIST STATS\n"))
+		return;
+
+	if (!stats_dump(stats_send, client))
+		return;
+
+	sendback(client, "END LIST STATS\n");
+}
+
 void net_list(nut_ctype_t *client, int numarg, const char **arg)
 {
 	if (numarg < 1) {
@@ -298,6 +319,12 @@ void net_list(nut_ctype_t *client, int numarg, const char **arg)
 		return;
 	}
 
+	/* LIST STATS */
+	if (!strcasecmp(arg[0], "STATS")) {
+		list_stats(client);
+		return;
+	}
+
 	if (numarg < 2) {
 		send_err(client, NUT_ERR_INVALID_ARGUMENT);
 		return;
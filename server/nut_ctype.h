@@ -57,6 +57,12 @@ typedef struct nut_ctype_s {
 
 	PCONF_CTX_t	ctx;
 
+	/* metrics, see stats.c */
+	time_t	connected;
+	unsigned long	commands;
+	unsigned long	bytes_in;
+	unsigned long	bytes_out;
+
 	/* doubly linked list */
 	struct nut_ctype_s	*prev;
 	struct nut_ctype_s	*next;
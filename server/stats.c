@@ -0,0 +1,281 @@
+/* stats.c - upsd internal metrics
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "common.h"
+
+#include "upsd.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <time.h>
+
+/* per command handler timings */
+typedef struct stats_cmd_s {
+	char	*name;
+	stats_hist_t	hist;
+	struct stats_cmd_s	*next;
+} stats_cmd_t;
+
+	/* set via STATSFILE in upsd.conf */
+	char	*statsfile = NULL;
+
+static stats_cmd_t	*cmdhead = NULL;
+static stats_hist_t	loop_hist;
+
+static time_t	started = 0, window_start = 0;
+static unsigned long	accepted = 0;
+static unsigned long	bytes_in = 0, bytes_out = 0;
+
+static const char	*bucket_name[STATS_BUCKETS] = {
+	"10us", "100us", "1ms", "10ms", "100ms", "1s", "inf"
+};
+
+static void hist_add(stats_hist_t *hist, double elapsed)
+{
+	double	limit;
+	int	i;
+
+	hist->count++;
+	hist->total += elapsed;
+
+	if (elapsed > hist->max) {
+		hist->max = elapsed;
+	}
+
+	for (i = 0, limit = 1e-5; (i < STATS_BUCKETS - 1) && (elapsed >= limit); i++, limit *= 10)
+		;
+
+	hist->bucket[i]++;
+}
+
+void stats_command(const char *name, double elapsed)
+{
+	stats_cmd_t	*cmd;
+
+	for (cmd = cmdhead; cmd; cmd = cmd->next) {
+		if (!strcmp(cmd->name, name)) {
+			break;
+		}
+	}
+
+	if (!cmd) {
+		cmd = xcalloc(1, sizeof(*cmd));
+		cmd->name = xstrdup(name);
+		cmd->next = cmdhead;
+		cmdhead = cmd;
+	}
+
+	hist_add(&cmd->hist, elapsed);
+}
+
+void stats_loop(double elapsed)
+{
+	hist_add(&loop_hist, elapsed);
+}
+
+void stats_connect(void)
+{
+	accepted++;
+}
+
+void stats_client_io(nut_ctype_t *client, int in, int out)
+{
+	client->bytes_in += in;
+	client->bytes_out += out;
+
+	bytes_in += in;
+	bytes_out += out;
+}
+
+static int emit_value(int (*emit)(const char *, const char *, void *), void *arg,
+	const char *prefix, const char *name, const char *fmt, ...)
+	__attribute__ ((__format__ (__printf__, 5, 6)));
+
+static int emit_value(int (*emit)(const char *, const char *, void *), void *arg,
+	const char *prefix, const char *name, const char *fmt, ...)
+{
+	char	var[SMALLBUF], val[SMALLBUF];
+	va_list	ap;
+
+	snprintf(var, sizeof(var), "%s.%s", prefix, name);
+
+	va_start(ap, fmt);
+	vsnprintf(val, sizeof(val), fmt, ap);
+	va_end(ap);
+
+	return emit(var, val, arg);
+}
+
+static int emit_hist(int (*emit)(const char *, const char *, void *), void *arg,
+	const char *prefix, const stats_hist_t *hist)
+{
+	char	val[SMALLBUF];
+	size_t	len = 0;
+	int	i;
+
+	if (!emit_value(emit, arg, prefix, "count", "%lu", hist->count))
+		return 0;
+
+	if (!emit_value(emit, arg, prefix, "latency.avg", "%.6f",
+		hist->count ? hist->total / hist->count : 0))
+		return 0;
+
+	if (!emit_value(emit, arg, prefix, "latency.max", "%.6f", hist->max))
+		return 0;
+
+	for (i = 0; i < STATS_BUCKETS; i++) {
+		len += snprintf(&val[len], sizeof(val) - len, "%s%s:%lu",
+			i ? " " : "", bucket_name[i], hist->bucket[i]);
+	}
+
+	return emit_value(emit, arg, prefix, "latency.hist", "%s", val);
+}
+
+int stats_dump(int (*emit)(const char *name, const char *value, void *arg), void *arg)
+{
+	upstype_t	*ups;
+	nut_ctype_t	*client;
+	stats_cmd_t	*cmd;
+	char	prefix[SMALLBUF];
+	int	clients = 0, drivers = 0;
+	time_t	now;
+
+	time(&now);
+
+	for (ups = firstups; ups; ups = ups->next) {
+		if (ups->sock_fd != -1) {
+			drivers++;
+		}
+	}
+
+	for (client = firstclient; client; client = client->next) {
+		clients++;
+	}
+
+	if (!emit_value(emit, arg, "server", "uptime", "%.0f", difftime(now, started)) ||
+		!emit_value(emit, arg, "server", "connections.clients", "%d", clients) ||
+		!emit_value(emit, arg, "server", "connections.drivers", "%d", drivers) ||
+		!emit_value(emit, arg, "server", "connections.accepted", "%lu", accepted) ||
+		!emit_value(emit, arg, "server", "bytes.in", "%lu", bytes_in) ||
+		!emit_value(emit, arg, "server", "bytes.out", "%lu", bytes_out) ||
+		!emit_hist(emit, arg, "server.loop", &loop_hist))
+		return 0;
+
+	for (cmd = cmdhead; cmd; cmd = cmd->next) {
+		snprintf(prefix, sizeof(prefix), "command.%s", cmd->name);
+
+		if (!emit_hist(emit, arg, prefix, &cmd->hist))
+			return 0;
+	}
+
+	for (ups = firstups; ups; ups = ups->next) {
+		snprintf(prefix, sizeof(prefix), "ups.%s", ups->name);
+
+		if (!emit_value(emit, arg, prefix, "updates", "%lu", ups->updates) ||
+			!emit_value(emit, arg, prefix, "updates.rate", "%.2f", ups->update_rate))
+			return 0;
+	}
+
+	/* clients are identified by their socket, and not by their username:
+	   LIST STATS is allowed before logging in */
+	for (client = firstclient; client; client = client->next) {
+		snprintf(prefix, sizeof(prefix), "client.%d", client->sock_fd);
+
+		if (!emit_value(emit, arg, prefix, "addr", "%s", client->addr) ||
+			!emit_value(emit, arg, prefix, "connected", "%.0f", difftime(now, client->connected)) ||
+			!emit_value(emit, arg, prefix, "commands", "%lu", client->commands) ||
+			!emit_value(emit, arg, prefix, "bytes.in", "%lu", client->bytes_in) ||
+			!emit_value(emit, arg, prefix, "bytes.out", "%lu", client->bytes_out))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int emit_file(const char *name, const char *value, void *arg)
+{
+	return (fprintf((FILE *)arg, "%s %s\n", name, value) > 0);
+}
+
+static void write_statsfile(void)
+{
+	char	fn[SMALLBUF];
+	FILE	*f;
+
+	snprintf(fn, sizeof(fn), "%s.tmp", statsfile);
+
+	f = fopen(fn, "w");
+
+	if (!f) {
+		upsdebug_with_errno(2, "Can't open %s", fn);
+		return;
+	}
+
+	stats_dump(emit_file, f);
+
+	if (fclose(f) || rename(fn, statsfile)) {
+		upsdebug_with_errno(2, "Can't write %s", statsfile);
+		unlink(fn);
+	}
+}
+
+void stats_tick(void)
+{
+	upstype_t	*ups;
+	double	elapsed;
+	time_t	now;
+
+	time(&now);
+
+	if (!started) {
+		started = window_start = now;
+	}
+
+	elapsed = difftime(now, window_start);
+
+	if (elapsed < STATS_WINDOW) {
+		return;
+	}
+
+	for (ups = firstups; ups; ups = ups->next) {
+		ups->update_rate = (ups->updates - ups->updates_mark) / elapsed;
+		ups->updates_mark = ups->updates;
+	}
+
+	window_start = now;
+
+	if (statsfile) {
+		write_statsfile();
+	}
+}
+
+void stats_free(void)
+{
+	stats_cmd_t	*cmd, *cnext;
+
+	for (cmd = cmdhead; cmd; cmd = cnext) {
+		cnext = cmd->next;
+
+		free(cmd->name);
+		free(cmd);
+	}
+
+	cmdhead = NULL;
+
+	free(statsfile);
+	statsfile = NULL;
+}
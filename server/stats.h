@@ -0,0 +1,64 @@
+/* stats.h - upsd internal metrics
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef STATS_H_SEEN
+#define STATS_H_SEEN 1
+
+#include "upsd.h"
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/* rates are computed over this many seconds, also the statsfile period */
+#define STATS_WINDOW	10
+
+/* latency histogram: 10us, 100us, 1ms, 10ms, 100ms, 1s and above */
+#define STATS_BUCKETS	7
+
+typedef struct {
+	unsigned long	count;
+	double	total;		/* seconds */
+	double	max;
+	unsigned long	bucket[STATS_BUCKETS];
+} stats_hist_t;
+
+extern char	*statsfile;
+
+/* the durations are measured with monotime() */
+void stats_command(const char *name, double elapsed);
+void stats_loop(double elapsed);
+void stats_connect(void);
+void stats_client_io(nut_ctype_t *client, int in, int out);
+
+/* called once per main loop iteration: rates and statsfile */
+void stats_tick(void);
+
+/* call emit for each metric, stop if it returns 0 */
+int stats_dump(int (*emit)(const char *name, const char *value, void *arg), void *arg);
+
+void stats_free(void);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+
+#endif	/* STATS_H_SEEN */
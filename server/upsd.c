@@ -39,6 +39,7 @@
 #include "sstate.h"
 #include "desc.h"
 #include "neterr.h"
+#include "stats.h"
 
 #ifdef HAVE_WRAP
 #include <tcpd.h>
@@ -334,6 +335,10 @@ int sendback(nut_ctype_t *client, const char *fmt, ...)
 		res = write(client->sock_fd, ans, len);
 	}
 
+	if (res > 0) {
+		stats_client_io(client, 0, res);
+	}
+
 	upsdebugx(2, "write: [destfd=%d] [len=%d] [%s]", client->sock_fd, len, rtrim(ans, '\n'));
 
 	if (len != res) {
@@ -399,6 +404,8 @@ int ups_available(const upstype_t *ups, nut_ctype_t *client)
 static void check_command(int cmdnum, nut_ctype_t *client, int numarg, 
 	const char **arg)
 {
+	double	start;
+
 	if (netcmds[cmdnum].flags & FLAG_USER) {
 #ifdef HAVE_WRAP
 		struct request_info	req;
@@ -427,7 +434,9 @@ static void check_command(int cmdnum, nut_ctype_t *client, int numarg,
 	}
 
 	/* looks good - call the command */
+	start = monotime();
 	netcmds[cmdnum].func(client, numarg - 1, &arg[1]);
+	stats_command(netcmds[cmdnum].name, monotime() - start);
 }
 
 /* parse requests from the network */
@@ -450,6 +459,7 @@ static void parse_net(nut_ctype_t *client)
 
 	/* fallthrough = not matched by any entry in netcmds */
 
+	stats_command("UNKNOWN", 0);
 	send_err(client, NUT_ERR_UNKNOWN_COMMAND);
 }
 
@@ -477,9 +487,12 @@ static void client_connect(stype_t *server)
 	client->sock_fd = fd;
 
 	time(&client->last_heard);
+	client->connected = client->last_heard;
 
 	client->addr = xstrdup(inet_ntopW(&csock));
 
+	stats_connect();
+
 	pconf_init(&client->ctx, NULL);
 
 	if (firstclient) {
@@ -527,6 +540,8 @@ static void client_readline(nut_ctype_t *client)
 		return;
 	}
 
+	stats_client_io(client, ret, 0);
+
 	/* fragment handling code */
 	for (i = 0; i < ret; i++) {
 
@@ -535,6 +550,7 @@ static void client_readline(nut_ctype_t *client)
 		{
 		case 1:
 			time(&client->last_heard);	/* command received */
+			client->commands++;
 			parse_net(client);
 			continue;
 
@@ -653,6 +669,8 @@ static void upsd_cleanup(void)
 
 	free(fds);
 	free(handler);
+
+	stats_free();
 }
 
 void poll_reload(void)
@@ -676,6 +694,7 @@ void poll_reload(void)
 static void mainloop(void)
 {
 	int	i, ret, nfds = 0;
+	double	start;
 
 	upstype_t	*ups;
 	nut_ctype_t		*client, *cnext;
@@ -684,6 +703,8 @@ static void mainloop(void)
 
 	time(&now);
 
+	stats_tick();
+
 	if (reload_flag) {
 		conf_reload();
 		poll_reload();
@@ -770,6 +791,8 @@ static void mainloop(void)
 		return;
 	}
 
+	start = monotime();
+
 	for (i = 0; i < nfds; i++) {
 
 		if (fds[i].revents & (POLLHUP|POLLERR|POLLNVAL)) {
@@ -814,6 +837,8 @@ static void mainloop(void)
 			continue;
 		}
 	}
+
+	stats_loop(monotime() - start);
 }
 
 static void help(const char *progname) 
@@ -1038,6 +1063,9 @@ int main(int argc, char **argv)
 		memset(pidfn, 0, sizeof(pidfn));
 	}
 
+	/* don't let the logging slow down the clients */
+	upslog_async();
+
 	while (!exit_flag) {
 		mainloop();
 	}
@@ -51,6 +51,11 @@ typedef struct upstype_s {
 	int	fsd;		/* forced shutdown in effect? */
 
 	int	retain;
+
+	/* metrics, see stats.c */
+	unsigned long	updates;	/* lines received from the driver */
+	unsigned long	updates_mark;
+	double	update_rate;
 	
 	struct upstype_s	*next;
 
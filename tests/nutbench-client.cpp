@@ -0,0 +1,52 @@
+/* nutbench-client - nutclient part of the microbenchmarks
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "nutclient.h"
+
+#include <cstddef>
+
+#include "nutbench.h"
+
+namespace
+{
+
+/* explode() and escape() are protected */
+class BenchClient : public nut::TcpClient
+{
+public:
+	static size_t explode(const std::string& str)
+	{
+		return TcpClient::explode(str).size();
+	}
+
+	static size_t escape(const std::string& str)
+	{
+		return TcpClient::escape(str).size();
+	}
+};
+
+} /* namespace */
+
+size_t nutbench_explode(const char *str)
+{
+	return BenchClient::explode(str);
+}
+
+size_t nutbench_escape(const char *str)
+{
+	return BenchClient::escape(str);
+}
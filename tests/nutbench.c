@@ -0,0 +1,501 @@
+/* nutbench - microbenchmarks of the core data paths
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* The results are printed one per line, as "<name> <iterations> <ns/op>",
+   so that two runs can be compared with the usual text tools:
+
+	make -C tests bench > before.txt
+	...
+	make -C tests bench > after.txt
+	join before.txt after.txt | awk '{ print $1, $3, $5 }'
+*/
+
+#include "common.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "state.h"
+#include "parseconf.h"
+#include "upsd.h"
+#include "sstate.h"
+#include "netlist.h"
+#include "stats.h"
+#include "dstate.h"
+#include "hidparser.h"
+#include "nutbench.h"
+
+/* minimum duration of each measure, in seconds */
+static double	mintime = 0.25;
+
+/* a typical variable set, completed up to the requested size */
+static const char	*varname[] = {
+	"battery.charge", "battery.charge.low", "battery.charge.warning",
+	"battery.date", "battery.mfr.date", "battery.runtime",
+	"battery.runtime.low", "battery.type", "battery.voltage",
+	"battery.voltage.nominal", "device.mfr", "device.model",
+	"device.serial", "device.type", "driver.name", "driver.parameter.pollfreq",
+	"driver.parameter.pollinterval", "driver.parameter.port",
+	"driver.version", "driver.version.data", "driver.version.internal",
+	"input.sensitivity", "input.transfer.high", "input.transfer.low",
+	"input.voltage", "input.voltage.nominal", "output.current",
+	"output.frequency", "output.voltage", "output.voltage.nominal",
+	"ups.beeper.status", "ups.delay.shutdown", "ups.delay.start",
+	"ups.firmware", "ups.firmware.aux", "ups.load", "ups.mfr",
+	"ups.mfr.date", "ups.model", "ups.productid", "ups.serial",
+	"ups.status", "ups.temperature", "ups.test.result",
+	"ups.timer.reboot", "ups.timer.shutdown", "ups.vendorid",
+	NULL
+};
+
+static char	**names = NULL;
+static int	numnames = 0;
+
+/* upsd stubs, net_list() output is formatted but goes nowhere */
+	upstype_t	*firstups = NULL;
+	nut_ctype_t	*firstclient = NULL;
+
+static upstype_t	bench_ups;
+static char	sink[ST_SOCK_BUF_LEN];
+
+upstype_t *get_ups_ptr(const char *upsname)
+{
+	return &bench_ups;
+}
+
+int ups_available(const upstype_t *ups, nut_ctype_t *client)
+{
+	return 1;
+}
+
+int sendback(nut_ctype_t *client, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	vsnprintf(sink, sizeof(sink), fmt, ap);
+	va_end(ap);
+
+	return 1;
+}
+
+int send_err(nut_ctype_t *client, const char *errtype)
+{
+	return 1;
+}
+
+const st_tree_t *sstate_getnode(const upstype_t *ups, const char *varname)
+{
+	return state_tree_find(ups->inforoot, varname);
+}
+
+int stats_dump(int (*emit)(const char *name, const char *value, void *arg), void *arg)
+{
+	return 1;
+}
+
+static void free_names(void)
+{
+	int	i;
+
+	for (i = 0; i < numnames; i++) {
+		free(names[i]);
+	}
+
+	free(names);
+
+	names = NULL;
+	numnames = 0;
+}
+
+static void set_names(int count)
+{
+	char	buf[SMALLBUF];
+	int	i;
+
+	free_names();
+
+	names = xcalloc(count, sizeof(*names));
+
+	for (i = 0; i < count; i++) {
+
+		if ((i < (int)(sizeof(varname) / sizeof(varname[0]) - 1))) {
+			names[i] = xstrdup(varname[i]);
+			continue;
+		}
+
+		snprintf(buf, sizeof(buf), "ups.bench.%03d", i);
+		names[i] = xstrdup(buf);
+	}
+
+	numnames = count;
+}
+
+static st_tree_t *make_tree(void)
+{
+	st_tree_t	*root = NULL;
+	int	i;
+
+	/* insert in a shuffled order, like a driver would */
+	for (i = 0; i < numnames; i++) {
+		state_setinfo(&root, names[(i * 7) % numnames], "230.0");
+	}
+
+	return root;
+}
+
+/* run func with more and more iterations until it takes long enough */
+static void bench_run(const char *name, const char *filter, void (*func)(unsigned long n))
+{
+	unsigned long	n;
+	double	start, elapsed;
+
+	if (filter && strncmp(name, filter, strlen(filter))) {
+		return;
+	}
+
+	for (n = 16; ; n *= 2) {
+		start = monotime();
+		func(n);
+		elapsed = monotime() - start;
+
+		if (elapsed >= mintime) {
+			break;
+		}
+	}
+
+	printf("%s %lu %.1f\n", name, n, elapsed * 1e9 / n);
+	fflush(stdout);
+}
+
+static void bench_state_find(unsigned long n)
+{
+	st_tree_t	*root = make_tree();
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		if (!state_tree_find(root, names[i % numnames])) {
+			fatalx(EXIT_FAILURE, "%s not found", names[i % numnames]);
+		}
+	}
+
+	state_infofree(root);
+}
+
+/* the value doesn't change: the common case for a driver update */
+static void bench_state_set_same(unsigned long n)
+{
+	st_tree_t	*root = make_tree();
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		state_setinfo(&root, names[i % numnames], "230.0");
+	}
+
+	state_infofree(root);
+}
+
+static void bench_state_set_changed(unsigned long n)
+{
+	st_tree_t	*root = make_tree();
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		state_setinfo(&root, names[i % numnames], ((i / numnames) & 1) ? "229.0" : "\"quoted\" 231.0");
+	}
+
+	state_infofree(root);
+}
+
+/* a driver update as seen by upsd */
+static const char	*sockdata =
+	"SETINFO ups.status \"OL CHRG\"\n"
+	"SETINFO battery.charge \"100\"\n"
+	"SETINFO input.voltage \"230.0\"\n"
+	"SETINFO ups.load \"17\"\n"
+	"SETINFO device.model \"Smart-UPS 1500 \\\"RM\\\"\"\n"
+	"DATAOK\n";
+
+static void bench_pconf_char(unsigned long n)
+{
+	PCONF_CTX_t	ctx;
+	const char	*p;
+	unsigned long	i;
+
+	pconf_init(&ctx, NULL);
+
+	for (i = 0; i < n; ) {
+		for (p = sockdata; *p; p++) {
+			if (pconf_char(&ctx, *p) == 1) {
+				i++;
+			}
+		}
+	}
+
+	pconf_finish(&ctx);
+}
+
+static void bench_list_var(unsigned long n)
+{
+	nut_ctype_t	client;
+	const char	*arg[] = { "VAR", "bench" };
+	unsigned long	i;
+
+	memset(&client, 0, sizeof(client));
+
+	bench_ups.name = "bench";
+	bench_ups.inforoot = make_tree();
+
+	for (i = 0; i < n; i++) {
+		net_list(&client, 2, arg);
+	}
+
+	state_infofree(bench_ups.inforoot);
+	bench_ups.inforoot = NULL;
+}
+
+#define BENCH_CLIENTS	4
+
+static int	clientfd[BENCH_CLIENTS];
+
+static void drain_clients(void)
+{
+	char	buf[LARGEBUF];
+	int	i;
+
+	for (i = 0; i < BENCH_CLIENTS; i++) {
+		while (read(clientfd[i], buf, sizeof(buf)) > 0)
+			;
+	}
+}
+
+/* dstate_setinfo() with a changed value is written to every upsd */
+static void bench_dstate_broadcast(unsigned long n)
+{
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		dstate_setinfo(names[i % numnames], "%lu", i);
+
+		/* stay well below the socket buffer */
+		if ((i & 63) == 63) {
+			drain_clients();
+		}
+	}
+
+	drain_clients();
+}
+
+static void dstate_setup(void)
+{
+	struct sockaddr_un	sa;
+	struct timeval	timeout;
+	char	path[SMALLBUF];
+	int	i;
+
+	snprintf(path, sizeof(path), "/tmp/nutbench-%d", (int)getpid());
+
+	if (mkdir(path, 0700) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "mkdir %s", path);
+	}
+
+	setenv("NUT_STATEPATH", path, 1);
+
+	dstate_init("nutbench", NULL);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "/tmp/nutbench-%d/nutbench", (int)getpid());
+
+	for (i = 0; i < BENCH_CLIENTS; i++) {
+		clientfd[i] = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if ((clientfd[i] < 0) || connect(clientfd[i], (struct sockaddr *)&sa, sizeof(sa))) {
+			fatal_with_errno(EXIT_FAILURE, "connect %s", sa.sun_path);
+		}
+
+		fcntl(clientfd[i], F_SETFL, fcntl(clientfd[i], F_GETFL, 0) | O_NONBLOCK);
+	}
+
+	/* let the driver side accept them */
+	gettimeofday(&timeout, NULL);
+	timeout.tv_usec += 100000;
+
+	if (timeout.tv_usec >= 1000000) {
+		timeout.tv_sec++;
+		timeout.tv_usec -= 1000000;
+	}
+
+	while (!dstate_poll_fds(timeout, -1))
+		;
+}
+
+static void dstate_cleanup(void)
+{
+	char	path[SMALLBUF];
+	int	i;
+
+	for (i = 0; i < BENCH_CLIENTS; i++) {
+		close(clientfd[i]);
+	}
+
+	dstate_free();
+
+	snprintf(path, sizeof(path), "/tmp/nutbench-%d/nutbench", (int)getpid());
+	unlink(path);
+
+	snprintf(path, sizeof(path), "/tmp/nutbench-%d", (int)getpid());
+	rmdir(path);
+}
+
+/* a 16 bit unsigned voltage, an 8 bit signed temperature and a 1 bit flag */
+static const struct {
+	uint8_t	offset, size;
+	long	logmin, logmax;
+} hid_item[] = {
+	{ 0, 16, 0, 0xffff },
+	{ 16, 8, -128, 127 },
+	{ 27, 1, 0, 1 }
+};
+
+#define HID_ITEMS	(sizeof(hid_item) / sizeof(hid_item[0]))
+
+static HIDData_t	hid_data[HID_ITEMS];
+
+static void hid_setup(void)
+{
+	unsigned int	i;
+
+	for (i = 0; i < HID_ITEMS; i++) {
+		hid_data[i].Offset = hid_item[i].offset;
+		hid_data[i].Size = hid_item[i].size;
+		hid_data[i].LogMin = hid_item[i].logmin;
+		hid_data[i].LogMax = hid_item[i].logmax;
+	}
+}
+
+static void bench_hid_getvalue(unsigned long n)
+{
+	unsigned char	buf[8] = { 0x01, 0x5c, 0x09, 0xe2, 0x08, 0, 0, 0 };
+	unsigned long	i;
+	long	value, sum = 0;
+
+	for (i = 0; i < n; i++) {
+		GetValue(buf, &hid_data[i % HID_ITEMS], &value);
+		sum += value;
+	}
+
+	upsdebugx(5, "%s: %ld", __func__, sum);
+}
+
+static void bench_hid_setvalue(unsigned long n)
+{
+	unsigned char	buf[8] = { 0x01 };
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		SetValue(&hid_data[i % HID_ITEMS], buf, i);
+	}
+}
+
+static void bench_explode(unsigned long n)
+{
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		nutbench_explode("VAR myups device.model \"Smart-UPS 1500 \\\"RM\\\"\"");
+	}
+}
+
+static void bench_escape(unsigned long n)
+{
+	unsigned long	i;
+
+	for (i = 0; i < n; i++) {
+		nutbench_escape("Smart-UPS 1500 \"RM\"");
+	}
+}
+
+static void help(const char *prog)
+{
+	printf("Microbenchmarks of the core data paths.\n\n");
+	printf("usage: %s [-h] [-t <seconds>] [<name>]\n\n", prog);
+	printf("  -h		- display this help\n");
+	printf("  -t <seconds>	- minimum duration of each measure (default: %.2f)\n", mintime);
+	printf("  <name>	- only run the benchmarks starting with <name>\n\n");
+	printf("Each result is printed as \"<name> <iterations> <ns/op>\".\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char	*filter = NULL;
+	char	name[SMALLBUF];
+	int	i, size[] = { 20, 100, 500 };
+
+	while ((i = getopt(argc, argv, "+ht:")) != -1) {
+		switch (i)
+		{
+		case 't':
+			mintime = atof(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (optind < argc) {
+		filter = argv[optind];
+	}
+
+	for (i = 0; i < (int)(sizeof(size) / sizeof(size[0])); i++) {
+		set_names(size[i]);
+
+		snprintf(name, sizeof(name), "state.find/%d", size[i]);
+		bench_run(name, filter, bench_state_find);
+
+		snprintf(name, sizeof(name), "state.setinfo.same/%d", size[i]);
+		bench_run(name, filter, bench_state_set_same);
+
+		snprintf(name, sizeof(name), "state.setinfo.changed/%d", size[i]);
+		bench_run(name, filter, bench_state_set_changed);
+
+		snprintf(name, sizeof(name), "upsd.list_var/%d", size[i]);
+		bench_run(name, filter, bench_list_var);
+	}
+
+	bench_run("pconf.char", filter, bench_pconf_char);
+
+	if (!filter || !strncmp("dstate", filter, strlen(filter))) {
+		set_names(100);
+		dstate_setup();
+		bench_run("dstate.broadcast/4", filter, bench_dstate_broadcast);
+		dstate_cleanup();
+	}
+
+	hid_setup();
+	bench_run("hid.getvalue", filter, bench_hid_getvalue);
+	bench_run("hid.setvalue", filter, bench_hid_setvalue);
+
+	bench_run("nutclient.explode", filter, bench_explode);
+	bench_run("nutclient.escape", filter, bench_escape);
+
+	free_names();
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,220 @@
+/* nutclienttest - CppUnit tests of the nutclient CachingClient
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "nutclient.h"
+
+namespace
+{
+
+typedef std::map<std::string,std::vector<std::string> > VariableMap;
+
+/* Serves the variables of one device from memory, counting the fetches. */
+class FakeClient : public nut::Client
+{
+public:
+  FakeClient():fetches(0){}
+
+  void set(const std::string& name, const std::string& value)
+  {
+    vars[name] = std::vector<std::string>(1, value);
+  }
+
+  virtual std::map<std::string,std::vector<std::string> > getDeviceVariableValues(const std::string& /*dev*/)throw(nut::NutException)
+  {
+    fetches++;
+    return vars;
+  }
+
+  virtual void authenticate(const std::string&, const std::string&)throw(nut::NutException) {}
+  virtual void logout()throw(nut::NutException) {}
+  virtual std::set<std::string> getDeviceNames()throw(nut::NutException) { return std::set<std::string>(); }
+  virtual std::string getDeviceDescription(const std::string&)throw(nut::NutException) { return ""; }
+  virtual std::set<std::string> getDeviceVariableNames(const std::string&)throw(nut::NutException) { return std::set<std::string>(); }
+  virtual std::set<std::string> getDeviceRWVariableNames(const std::string&)throw(nut::NutException) { return std::set<std::string>(); }
+  virtual std::string getDeviceVariableDescription(const std::string&, const std::string&)throw(nut::NutException) { return ""; }
+  virtual std::vector<std::string> getDeviceVariableValue(const std::string&, const std::string&)throw(nut::NutException) { throw nut::NutException("UNEXPECTED"); }
+  virtual void setDeviceVariable(const std::string&, const std::string&, const std::string&)throw(nut::NutException) {}
+  virtual void setDeviceVariable(const std::string&, const std::string&, const std::vector<std::string>&)throw(nut::NutException) {}
+  virtual std::set<std::string> getDeviceCommandNames(const std::string&)throw(nut::NutException) { return std::set<std::string>(); }
+  virtual std::string getDeviceCommandDescription(const std::string&, const std::string&)throw(nut::NutException) { return ""; }
+  virtual void executeDeviceCommand(const std::string&, const std::string&)throw(nut::NutException) {}
+  virtual void deviceLogin(const std::string&)throw(nut::NutException) {}
+  virtual void deviceMaster(const std::string&)throw(nut::NutException) {}
+  virtual void deviceForcedShutdown(const std::string&)throw(nut::NutException) {}
+  virtual int deviceGetNumLogins(const std::string&)throw(nut::NutException) { return 0; }
+
+  VariableMap vars;
+  int fetches;
+};
+
+/* Records the notifications, and what the client returns meanwhile. */
+class RecordingListener : public nut::VariableListener
+{
+public:
+  RecordingListener(nut::CachingClient* client = NULL):_client(client), throws(false){}
+
+  virtual void variableChanged(const std::string& dev, const std::string& name, const std::vector<std::string>& value)
+  {
+    std::string event = "changed " + dev + " " + name + " " + value[0];
+
+    if(_client)
+    {
+      event += " read " + _client->getDeviceVariableValue(dev, name)[0];
+    }
+    events.push_back(event);
+
+    if(throws)
+    {
+      throw nut::NutException("listener failure");
+    }
+  }
+
+  virtual void variableRemoved(const std::string& dev, const std::string& name)
+  {
+    events.push_back("removed " + dev + " " + name);
+  }
+
+  nut::CachingClient* _client;
+  bool throws;
+  std::vector<std::string> events;
+};
+
+} /* namespace */
+
+class NutClientTest : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE( NutClientTest );
+    CPPUNIT_TEST( testInitialValues );
+    CPPUNIT_TEST( testChanges );
+    CPPUNIT_TEST( testReadBack );
+    CPPUNIT_TEST( testThrowingListener );
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  NutClientTest():client(&fake, 3600){}
+
+  void setUp();
+  void tearDown();
+
+  void testInitialValues();
+  void testChanges();
+  void testReadBack();
+  void testThrowingListener();
+
+private:
+  FakeClient fake;
+  nut::CachingClient client;
+};
+
+// Registers the fixture into the 'registry'
+CPPUNIT_TEST_SUITE_REGISTRATION( NutClientTest );
+
+
+void NutClientTest::setUp()
+{
+  fake.set("battery.charge", "100");
+  fake.set("input.voltage", "230");
+  fake.set("ups.status", "OL");
+
+  client.watchDevice("ups");
+}
+
+
+void NutClientTest::tearDown()
+{
+}
+
+
+void NutClientTest::testInitialValues()
+{
+  RecordingListener listener;
+  client.addListener(&listener);
+
+  CPPUNIT_ASSERT( client.poll() );
+  CPPUNIT_ASSERT_EQUAL( (size_t)0, listener.events.size() );
+  CPPUNIT_ASSERT_EQUAL( 1, fake.fetches );
+
+  // Fresh enough: served from the mirror
+  CPPUNIT_ASSERT( !client.poll() );
+  CPPUNIT_ASSERT_EQUAL( std::string("OL"), client.getDeviceVariableValue("ups", "ups.status")[0] );
+  CPPUNIT_ASSERT_EQUAL( 1, fake.fetches );
+}
+
+
+void NutClientTest::testChanges()
+{
+  RecordingListener listener;
+  client.addListener(&listener);
+  client.refresh();
+
+  fake.vars.erase("battery.charge");
+  fake.set("input.voltage", "231");
+  fake.set("output.voltage", "230");
+  client.refresh();
+
+  // Removed, changed and added variables, in name order; not the unchanged one
+  CPPUNIT_ASSERT_EQUAL( (size_t)3, listener.events.size() );
+  CPPUNIT_ASSERT_EQUAL( std::string("removed ups battery.charge"), listener.events[0] );
+  CPPUNIT_ASSERT_EQUAL( std::string("changed ups input.voltage 231"), listener.events[1] );
+  CPPUNIT_ASSERT_EQUAL( std::string("changed ups output.voltage 230"), listener.events[2] );
+
+  // Nothing changed
+  client.refresh();
+  CPPUNIT_ASSERT_EQUAL( (size_t)3, listener.events.size() );
+}
+
+
+void NutClientTest::testReadBack()
+{
+  RecordingListener listener(&client);
+  client.addListener(&listener);
+  client.refresh();
+
+  fake.set("ups.status", "OB");
+  client.refresh();
+
+  // The listener sees the new value, without fetching again
+  CPPUNIT_ASSERT_EQUAL( (size_t)1, listener.events.size() );
+  CPPUNIT_ASSERT_EQUAL( std::string("changed ups ups.status OB read OB"), listener.events[0] );
+  CPPUNIT_ASSERT_EQUAL( 2, fake.fetches );
+
+  // Even when the mirror is refreshed on each access
+  client.setRefreshInterval(0);
+  fake.set("ups.status", "OL");
+  client.refresh();
+
+  CPPUNIT_ASSERT_EQUAL( (size_t)2, listener.events.size() );
+  CPPUNIT_ASSERT_EQUAL( std::string("changed ups ups.status OL read OL"), listener.events[1] );
+}
+
+
+void NutClientTest::testThrowingListener()
+{
+  RecordingListener listener;
+  client.addListener(&listener);
+  client.refresh();
+
+  listener.throws = true;
+  fake.set("ups.status", "OB");
+  CPPUNIT_ASSERT_THROW( client.refresh(), nut::NutException );
+
+  // The mirror was updated anyway
+  listener.throws = false;
+  CPPUNIT_ASSERT_EQUAL( std::string("OB"), client.getDeviceVariableValue("ups", "ups.status")[0] );
+  CPPUNIT_ASSERT_EQUAL( 2, fake.fetches );
+}
@@ -0,0 +1,948 @@
+/* nutload - load generator for upsd, with simulated drivers and clients
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* The simulated drivers listen on the driver sockets in the state path,
+   like dstate.c, and upsd connects to them as usual.  A typical run:
+
+	nutload -g -d 1000 > $NUT_CONFPATH/ups.conf
+	upsd
+	nutload -d 1000 -r 0.5 -c 50 -t 60
+
+   The results are printed as "<name> <value>" lines. */
+
+#include "common.h"
+
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+
+#include "parseconf.h"
+
+/* the driver name used in ups.conf, hence in the socket names */
+#define LOAD_DRIVER	"nutload"
+
+typedef struct {
+	char	name[16];
+	int	sockfd;		/* listening socket */
+	int	fd;		/* connection from upsd */
+	PCONF_CTX_t	ctx;
+	int	dumped;
+	double	next;		/* next update */
+	unsigned long	seq;
+} load_driver_t;
+
+enum { REQ_LIST = 0, REQ_GET, REQ_INSTCMD, REQ_TYPES };
+
+static const char	*req_name[REQ_TYPES] = { "list", "get", "instcmd" };
+
+typedef struct {
+	double	*val;		/* latencies, in seconds */
+	size_t	num, max;
+	unsigned long	errors;
+} load_lat_t;
+
+typedef struct {
+	int	fd;
+	int	req;		/* request in progress, -1 if none */
+	double	sent;
+	double	next;		/* next request, with a think time */
+	char	buf[LARGEBUF];
+	size_t	len;
+} load_client_t;
+
+static load_driver_t	*driver = NULL;
+static load_client_t	*client = NULL;
+static load_lat_t	lat[REQ_TYPES];
+
+static int	drivers = 10, clients = 10;
+static double	rate = 1, think = 0, duration = 30, warmup = 10;
+static int	weight[REQ_TYPES] = { 1, 8, 1 };
+static const char	*host = "localhost", *port = NULL;
+static const char	*username = NULL, *password = NULL;
+static const char	*statepath = NULL;
+static int	upsd_pid = -1;
+
+/* driver side counters */
+static unsigned long	updates = 0, drops = 0, pings = 0, instcmds = 0;
+static unsigned long	disconnects = 0;
+
+/* --- simulated drivers --- */
+
+static int driver_send(load_driver_t *drv, const char *fmt, ...)
+	__attribute__ ((__format__ (__printf__, 2, 3)));
+
+static int driver_send(load_driver_t *drv, const char *fmt, ...)
+{
+	char	buf[LARGEBUF];
+	va_list	ap;
+	int	ret;
+
+	if (drv->fd < 0) {
+		return 0;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	ret = write(drv->fd, buf, strlen(buf));
+
+	/* like dstate.c: don't wait for a slow upsd */
+	if (ret != (int)strlen(buf)) {
+		upsdebugx(2, "%s: write to upsd failed", drv->name);
+		drops++;
+
+		close(drv->fd);
+		drv->fd = -1;
+		drv->dumped = 0;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+static void driver_dump(load_driver_t *drv)
+{
+	driver_send(drv,
+		"SETINFO device.mfr \"NUT\"\n"
+		"SETINFO device.model \"Load Generator\"\n"
+		"SETINFO device.serial \"%s\"\n"
+		"SETINFO device.type \"ups\"\n"
+		"SETINFO driver.name \"%s\"\n"
+		"SETINFO driver.version \"%s\"\n"
+		"SETINFO battery.charge \"100\"\n"
+		"SETINFO battery.charge.low \"10\"\n"
+		"SETINFO battery.runtime \"1800\"\n"
+		"SETINFO battery.voltage \"27.0\"\n"
+		"SETINFO battery.voltage.nominal \"24.0\"\n"
+		"SETINFO input.frequency \"50.0\"\n"
+		"SETINFO input.voltage \"230.0\"\n"
+		"SETINFO input.voltage.nominal \"230\"\n"
+		"SETINFO output.voltage \"230.0\"\n"
+		"SETINFO ups.beeper.status \"enabled\"\n"
+		"SETINFO ups.delay.shutdown \"20\"\n"
+		"SETFLAGS ups.delay.shutdown RW STRING\n"
+		"SETAUX ups.delay.shutdown 3\n"
+		"SETINFO ups.load \"25\"\n"
+		"SETINFO ups.status \"OL\"\n"
+		"SETINFO ups.temperature \"30.0\"\n"
+		"ADDCMD test.battery.start\n"
+		"ADDCMD beeper.toggle\n"
+		"DATAOK\n"
+		"DUMPDONE\n",
+		drv->name, LOAD_DRIVER, UPS_VERSION);
+
+	drv->dumped = (drv->fd >= 0);
+}
+
+static void driver_update(load_driver_t *drv)
+{
+	unsigned long	seq = ++drv->seq;
+
+	if (!driver_send(drv,
+		"SETINFO input.voltage \"%lu.%lu\"\n"
+		"SETINFO ups.load \"%lu\"\n"
+		"SETINFO battery.charge \"%lu\"\n",
+		220 + seq % 20, seq % 10, 20 + seq % 10, 90 + seq % 11)) {
+		return;
+	}
+
+	if ((seq % 10) == 0) {
+		driver_send(drv, "SETINFO ups.status \"%s\"\n", (seq % 20) ? "OL CHRG" : "OL");
+	}
+
+	updates++;
+}
+
+static void driver_arg(load_driver_t *drv, int numarg, char **arg)
+{
+	if (numarg < 1) {
+		return;
+	}
+
+	if (!strcasecmp(arg[0], "DUMPALL")) {
+		driver_dump(drv);
+		return;
+	}
+
+	if (!strcasecmp(arg[0], "PING")) {
+		pings++;
+		driver_send(drv, "PONG\n");
+		return;
+	}
+
+	if (!strcasecmp(arg[0], "INSTCMD")) {
+		instcmds++;
+		return;
+	}
+
+	upsdebugx(2, "%s: ignoring %s", drv->name, arg[0]);
+}
+
+static void driver_read(load_driver_t *drv)
+{
+	char	buf[SMALLBUF];
+	int	i, ret;
+
+	ret = read(drv->fd, buf, sizeof(buf));
+
+	if (ret <= 0) {
+		upsdebugx(2, "%s: upsd disconnected", drv->name);
+
+		close(drv->fd);
+		drv->fd = -1;
+		drv->dumped = 0;
+		return;
+	}
+
+	for (i = 0; i < ret; i++) {
+		if (pconf_char(&drv->ctx, buf[i]) == 1) {
+			driver_arg(drv, drv->ctx.numargs, drv->ctx.arglist);
+		}
+	}
+}
+
+static void driver_accept(load_driver_t *drv)
+{
+	int	fd;
+
+	fd = accept(drv->sockfd, NULL, NULL);
+
+	if (fd < 0) {
+		upsdebug_with_errno(2, "%s: accept failed", drv->name);
+		return;
+	}
+
+	/* upsd reconnected, forget the old connection */
+	if (drv->fd >= 0) {
+		close(drv->fd);
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	drv->fd = fd;
+	drv->dumped = 0;
+
+	pconf_finish(&drv->ctx);
+	pconf_init(&drv->ctx, NULL);
+}
+
+static void driver_open(load_driver_t *drv, int num)
+{
+	struct sockaddr_un	sa;
+
+	snprintf(drv->name, sizeof(drv->name), "load%04d", num);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "%s/%s-%s", statepath, LOAD_DRIVER, drv->name);
+
+	unlink(sa.sun_path);
+
+	drv->sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (drv->sockfd < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't create a unix domain socket");
+	}
+
+	if (bind(drv->sockfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't bind %s", sa.sun_path);
+	}
+
+	if (listen(drv->sockfd, 1) < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't listen on %s", sa.sun_path);
+	}
+
+	fcntl(drv->sockfd, F_SETFL, fcntl(drv->sockfd, F_GETFL, 0) | O_NONBLOCK);
+
+	drv->fd = -1;
+	pconf_init(&drv->ctx, NULL);
+
+	/* spread the updates over the period */
+	drv->next = monotime() + (double)num / drivers / rate;
+}
+
+static void driver_close(load_driver_t *drv)
+{
+	char	fn[SMALLBUF];
+
+	if (drv->fd >= 0) {
+		close(drv->fd);
+	}
+
+	close(drv->sockfd);
+	pconf_finish(&drv->ctx);
+
+	snprintf(fn, sizeof(fn), "%s/%s-%s", statepath, LOAD_DRIVER, drv->name);
+	unlink(fn);
+}
+
+/* --- simulated clients --- */
+
+static void lat_add(load_lat_t *l, double val)
+{
+	if (l->num == l->max) {
+		l->max = l->max ? l->max * 2 : 1024;
+		l->val = xrealloc(l->val, l->max * sizeof(*l->val));
+	}
+
+	l->val[l->num++] = val;
+}
+
+static int lat_cmp(const void *a, const void *b)
+{
+	double	da = *(const double *)a, db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+static int client_connect(void)
+{
+	struct addrinfo	hints, *res, *ai;
+	int	fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host, port, &hints, &res)) {
+		fatalx(EXIT_FAILURE, "Can't resolve %s", host);
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+		if (fd < 0) {
+			continue;
+		}
+
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+
+	if (fd < 0) {
+		fatal_with_errno(EXIT_FAILURE, "Can't connect to upsd on %s port %s", host, port);
+	}
+
+	return fd;
+}
+
+/* blocking exchange, only used to log in */
+static void client_command(int fd, const char *cmd, const char *arg)
+{
+	char	buf[SMALLBUF];
+	size_t	len = 0;
+
+	snprintf(buf, sizeof(buf), "%s %s\n", cmd, arg);
+
+	if (write(fd, buf, strlen(buf)) != (int)strlen(buf)) {
+		fatal_with_errno(EXIT_FAILURE, "Can't send %s", cmd);
+	}
+
+	while ((len < sizeof(buf) - 1) && (read(fd, &buf[len], 1) == 1) && (buf[len] != '\n')) {
+		len++;
+	}
+
+	buf[len] = '\0';
+
+	if (strncmp(buf, "OK", 2)) {
+		fatalx(EXIT_FAILURE, "%s failed: %s", cmd, buf);
+	}
+}
+
+static void client_open(load_client_t *cl)
+{
+	cl->fd = client_connect();
+
+	if (username) {
+		client_command(cl->fd, "USERNAME", username);
+		client_command(cl->fd, "PASSWORD", password ? password : "");
+	}
+
+	fcntl(cl->fd, F_SETFL, fcntl(cl->fd, F_GETFL, 0) | O_NONBLOCK);
+
+	cl->req = -1;
+	cl->next = monotime();
+}
+
+static int pick_request(void)
+{
+	int	i, total = 0, n;
+
+	for (i = 0; i < REQ_TYPES; i++) {
+		total += weight[i];
+	}
+
+	n = random() % total;
+
+	for (i = 0; n >= weight[i]; i++) {
+		n -= weight[i];
+	}
+
+	return i;
+}
+
+static void client_send(load_client_t *cl)
+{
+	char	buf[SMALLBUF];
+	const char	*ups = driver[random() % drivers].name;
+
+	cl->req = pick_request();
+
+	switch (cl->req)
+	{
+	case REQ_LIST:
+		snprintf(buf, sizeof(buf), "LIST VAR %s\n", ups);
+		break;
+	case REQ_GET:
+		snprintf(buf, sizeof(buf), "GET VAR %s ups.status\n", ups);
+		break;
+	default:
+		snprintf(buf, sizeof(buf), "INSTCMD %s test.battery.start\n", ups);
+		break;
+	}
+
+	cl->sent = monotime();
+
+	if (write(cl->fd, buf, strlen(buf)) != (int)strlen(buf)) {
+		upsdebug_with_errno(2, "client write failed");
+		disconnects++;
+
+		close(cl->fd);
+		cl->fd = -1;
+	}
+}
+
+/* returns 1 when the reply to the current request is complete */
+static int client_line(load_client_t *cl, const char *line)
+{
+	if (!strncmp(line, "ERR", 3)) {
+		lat[cl->req].errors++;
+		return 1;
+	}
+
+	if (cl->req != REQ_LIST) {
+		return 1;
+	}
+
+	return (!strncmp(line, "END LIST", 8));
+}
+
+static void client_read(load_client_t *cl)
+{
+	char	*eol;
+	int	ret;
+
+	ret = read(cl->fd, &cl->buf[cl->len], sizeof(cl->buf) - cl->len - 1);
+
+	if (ret <= 0) {
+		upsdebugx(2, "upsd closed a client connection");
+		disconnects++;
+
+		close(cl->fd);
+		cl->fd = -1;
+		return;
+	}
+
+	cl->len += ret;
+	cl->buf[cl->len] = '\0';
+
+	while ((eol = strchr(cl->buf, '\n')) != NULL) {
+		*eol = '\0';
+
+		if ((cl->req >= 0) && client_line(cl, cl->buf)) {
+			double	t = monotime();
+
+			lat_add(&lat[cl->req], t - cl->sent);
+
+			cl->req = -1;
+			cl->next = t + think;
+		}
+
+		cl->len -= (eol + 1 - cl->buf);
+		memmove(cl->buf, eol + 1, cl->len + 1);
+	}
+
+	/* a line longer than the buffer, drop it */
+	if (cl->len == sizeof(cl->buf) - 1) {
+		cl->len = 0;
+	}
+}
+
+/* --- upsd resource usage --- */
+
+/* CPU time and resident size from /proc, returns 0 if not available */
+static int upsd_usage(double *cpu, long *rss)
+{
+	char	fn[SMALLBUF], buf[LARGEBUF], *p;
+	unsigned long	utime, stime;
+	FILE	*f;
+
+	if (upsd_pid < 0) {
+		return 0;
+	}
+
+	snprintf(fn, sizeof(fn), "/proc/%d/stat", upsd_pid);
+
+	f = fopen(fn, "r");
+
+	if (!f) {
+		return 0;
+	}
+
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+
+	/* skip the command name, which may contain spaces */
+	if (!p || ((p = strrchr(buf, ')')) == NULL)) {
+		return 0;
+	}
+
+	if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+		return 0;
+	}
+
+	*cpu = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+	*rss = 0;
+
+	snprintf(fn, sizeof(fn), "/proc/%d/status", upsd_pid);
+
+	f = fopen(fn, "r");
+
+	if (!f) {
+		return 1;
+	}
+
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "VmRSS: %ld", rss) == 1) {
+			break;
+		}
+	}
+
+	fclose(f);
+
+	return 1;
+}
+
+static void upsd_findpid(void)
+{
+	char	fn[SMALLBUF];
+	FILE	*f;
+
+	if (upsd_pid >= 0) {
+		return;
+	}
+
+	snprintf(fn, sizeof(fn), "%s/upsd.pid", altpidpath());
+
+	f = fopen(fn, "r");
+
+	if (!f) {
+		return;
+	}
+
+	if (fscanf(f, "%d", &upsd_pid) != 1) {
+		upsd_pid = -1;
+	}
+
+	fclose(f);
+}
+
+/* --- main loop --- */
+
+static void run(double end, int measure)
+{
+	struct pollfd	*fds;
+	int	i, nfds, timeout;
+	double	t;
+
+	fds = xcalloc(2 * drivers + clients, sizeof(*fds));
+
+	while ((t = monotime()) < end) {
+
+		double	next = end;
+
+		if (!measure) {
+			for (i = 0; (i < drivers) && driver[i].dumped; i++)
+				;
+
+			/* all the drivers are known to upsd, which is done
+			   starting once it has written its pid file */
+			if (i == drivers) {
+				upsd_findpid();
+
+				if (upsd_pid >= 0) {
+					break;
+				}
+			}
+		}
+
+		for (i = 0; i < drivers; i++) {
+			load_driver_t	*drv = &driver[i];
+
+			if (!drv->dumped) {
+				continue;
+			}
+
+			if (drv->next <= t) {
+				driver_update(drv);
+				drv->next += 1 / rate;
+
+				/* don't try to catch up after a stall */
+				if (drv->next < t) {
+					drv->next = t + 1 / rate;
+				}
+			}
+
+			if (drv->next < next) {
+				next = drv->next;
+			}
+		}
+
+		for (i = 0; measure && (i < clients); i++) {
+			load_client_t	*cl = &client[i];
+
+			if ((cl->fd < 0) || (cl->req >= 0)) {
+				continue;
+			}
+
+			if (cl->next <= t) {
+				client_send(cl);
+			} else if (cl->next < next) {
+				next = cl->next;
+			}
+		}
+
+		nfds = 0;
+
+		for (i = 0; i < drivers; i++) {
+			fds[nfds].fd = driver[i].sockfd;
+			fds[nfds++].events = POLLIN;
+
+			fds[nfds].fd = driver[i].fd;
+			fds[nfds++].events = POLLIN;
+		}
+
+		for (i = 0; i < clients; i++) {
+			fds[nfds].fd = measure ? client[i].fd : -1;
+			fds[nfds++].events = POLLIN;
+		}
+
+		timeout = (next - t) * 1000 + 1;
+
+		if (timeout > 100) {
+			timeout = 100;
+		}
+
+		if (poll(fds, nfds, timeout) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			fatal_with_errno(EXIT_FAILURE, "poll");
+		}
+
+		for (i = 0; i < drivers; i++) {
+			if (fds[2 * i].revents & POLLIN) {
+				driver_accept(&driver[i]);
+			}
+
+			/* not if the polled connection was just replaced */
+			if ((fds[2 * i + 1].fd >= 0) && fds[2 * i + 1].revents &&
+				(fds[2 * i + 1].fd == driver[i].fd)) {
+				driver_read(&driver[i]);
+			}
+		}
+
+		for (i = 0; i < clients; i++) {
+			if ((client[i].fd >= 0) && fds[2 * drivers + i].revents) {
+				client_read(&client[i]);
+			}
+		}
+	}
+
+	free(fds);
+}
+
+static void report(double elapsed, double cpu)
+{
+	double	cpu_end;
+	long	rss;
+	int	i, connected = 0;
+
+	printf("duration %.3f\n", elapsed);
+
+	for (i = 0; i < drivers; i++) {
+		connected += driver[i].dumped;
+	}
+
+	printf("drivers %d\n", drivers);
+	printf("drivers.connected %d\n", connected);
+	printf("drivers.updates %lu\n", updates);
+	printf("drivers.updates.rate %.1f\n", updates / elapsed);
+	printf("drivers.drops %lu\n", drops);
+	printf("drivers.pings %lu\n", pings);
+	printf("drivers.instcmds %lu\n", instcmds);
+
+	printf("clients %d\n", clients);
+	printf("clients.disconnects %lu\n", disconnects);
+
+	for (i = 0; i < REQ_TYPES; i++) {
+		load_lat_t	*l = &lat[i];
+
+		printf("%s.count %lu\n", req_name[i], (unsigned long)l->num);
+		printf("%s.errors %lu\n", req_name[i], l->errors);
+		printf("%s.rate %.1f\n", req_name[i], l->num / elapsed);
+
+		if (l->num == 0) {
+			continue;
+		}
+
+		qsort(l->val, l->num, sizeof(*l->val), lat_cmp);
+
+		printf("%s.latency.p50 %.6f\n", req_name[i], l->val[(l->num - 1) * 50 / 100]);
+		printf("%s.latency.p90 %.6f\n", req_name[i], l->val[(l->num - 1) * 90 / 100]);
+		printf("%s.latency.p99 %.6f\n", req_name[i], l->val[(l->num - 1) * 99 / 100]);
+		printf("%s.latency.p999 %.6f\n", req_name[i], l->val[(l->num - 1) * 999 / 1000]);
+		printf("%s.latency.max %.6f\n", req_name[i], l->val[l->num - 1]);
+	}
+
+	if ((cpu >= 0) && upsd_usage(&cpu_end, &rss)) {
+		printf("upsd.pid %d\n", upsd_pid);
+		printf("upsd.cpu %.1f\n", 100 * (cpu_end - cpu) / elapsed);
+		printf("upsd.rss %ld\n", rss);
+	}
+}
+
+static void set_mix(char *mix)
+{
+	char	*tok, *val;
+	int	i;
+
+	memset(weight, 0, sizeof(weight));
+
+	for (tok = strtok(mix, ","); tok; tok = strtok(NULL, ",")) {
+
+		val = strchr(tok, ':');
+
+		if (val) {
+			*val++ = '\0';
+		}
+
+		for (i = 0; (i < REQ_TYPES) && strcmp(tok, req_name[i]); i++)
+			;
+
+		if (i == REQ_TYPES) {
+			fatalx(EXIT_FAILURE, "Unknown request type %s", tok);
+		}
+
+		weight[i] = val ? atoi(val) : 1;
+	}
+
+	for (i = 0; (i < REQ_TYPES) && (weight[i] <= 0); i++)
+		;
+
+	if (i == REQ_TYPES) {
+		fatalx(EXIT_FAILURE, "No request in the mix");
+	}
+}
+
+static void raise_nofile(void)
+{
+	struct rlimit	rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+		return;
+	}
+
+	if (rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+}
+
+static void help(const char *prog)
+{
+	printf("Load generator for upsd, with simulated drivers and clients.\n\n");
+	printf("usage: %s [OPTIONS]\n\n", prog);
+
+	printf("  -h		- display this help\n");
+	printf("  -D		- raise debugging level\n");
+	printf("  -g		- print the ups.conf sections for the drivers and exit\n");
+	printf("  -d <num>	- number of drivers (default: %d)\n", drivers);
+	printf("  -r <rate>	- updates per second of each driver (default: %g)\n", rate);
+	printf("  -c <num>	- number of clients (default: %d)\n", clients);
+	printf("  -m <mix>	- requests mix (default: list:1,get:8,instcmd:1)\n");
+	printf("  -i <seconds>	- think time of the clients between requests (default: %g)\n", think);
+	printf("  -t <seconds>	- duration of the measure (default: %g)\n", duration);
+	printf("  -w <seconds>	- maximum wait for upsd to connect to the drivers (default: %g)\n", warmup);
+	printf("  -H <host>	- upsd host (default: %s)\n", host);
+	printf("  -p <port>	- upsd port (default: %d)\n", PORT);
+	printf("  -u <user>	- log in as <user> (for INSTCMD)\n");
+	printf("  -P <password>	- password of <user>\n");
+	printf("  -s <path>	- state path, for the driver sockets (default: %s)\n", dflt_statepath());
+	printf("  -x <pid>	- pid of upsd (default: read from %s/upsd.pid)\n", altpidpath());
+	printf("\nThe results are printed as \"<name> <value>\" lines.\n");
+}
+
+int main(int argc, char **argv)
+{
+	double	start, cpu = -1;
+	long	rss;
+	int	i, genconf = 0;
+	char	portbuf[16];
+
+	while ((i = getopt(argc, argv, "+hDgd:r:c:m:i:t:w:H:p:u:P:s:x:")) != -1) {
+		switch (i)
+		{
+		case 'D':
+			nut_debug_level++;
+			break;
+		case 'g':
+			genconf = 1;
+			break;
+		case 'd':
+			drivers = atoi(optarg);
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'c':
+			clients = atoi(optarg);
+			break;
+		case 'm':
+			set_mix(optarg);
+			break;
+		case 'i':
+			think = atof(optarg);
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		case 'w':
+			warmup = atof(optarg);
+			break;
+		case 'H':
+			host = optarg;
+			break;
+		case 'p':
+			port = optarg;
+			break;
+		case 'u':
+			username = optarg;
+			break;
+		case 'P':
+			password = optarg;
+			break;
+		case 's':
+			statepath = optarg;
+			break;
+		case 'x':
+			upsd_pid = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if ((drivers < 1) || (clients < 0) || (rate <= 0)) {
+		fatalx(EXIT_FAILURE, "Invalid number of drivers, clients or update rate");
+	}
+
+	if (genconf) {
+		for (i = 0; i < drivers; i++) {
+			printf("[load%04d]\n\tdriver = %s\n\tport = none\n\n", i, LOAD_DRIVER);
+		}
+
+		exit(EXIT_SUCCESS);
+	}
+
+	if (!statepath) {
+		statepath = dflt_statepath();
+	}
+
+	if (!port) {
+		snprintf(portbuf, sizeof(portbuf), "%d", PORT);
+		port = portbuf;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	raise_nofile();
+
+	driver = xcalloc(drivers, sizeof(*driver));
+	client = xcalloc(clients, sizeof(*client));
+
+	for (i = 0; i < drivers; i++) {
+		driver_open(&driver[i], i);
+	}
+
+	/* wait for upsd to pick up the drivers */
+	start = monotime();
+	run(start + warmup, 0);
+
+	for (i = 0; (i < drivers) && driver[i].dumped; i++)
+		;
+
+	upslogx(LOG_INFO, "%d of %d drivers connected after %.1f seconds",
+		i, drivers, monotime() - start);
+
+	for (i = 0; i < clients; i++) {
+		client_open(&client[i]);
+	}
+
+	if (!upsd_usage(&cpu, &rss)) {
+		cpu = -1;
+	}
+
+	/* the counters only cover the measure */
+	updates = drops = pings = instcmds = 0;
+
+	start = monotime();
+	run(start + duration, 1);
+
+	report(monotime() - start, cpu);
+
+	for (i = 0; i < clients; i++) {
+		if (client[i].fd >= 0) {
+			close(client[i].fd);
+		}
+	}
+
+	for (i = 0; i < drivers; i++) {
+		driver_close(&driver[i]);
+	}
+
+	for (i = 0; i < REQ_TYPES; i++) {
+		free(lat[i].val);
+	}
+
+	free(driver);
+	free(client);
+
+	exit(EXIT_SUCCESS);
+}
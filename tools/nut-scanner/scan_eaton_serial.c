@@ -57,6 +57,10 @@ static nutscan_device_t * dev_ret = NULL;
 /* Remap some functions to avoid undesired behavior (drivers/main.c) */
 char *getval(const char *var) { return NULL; }
 
+/* Same for drivers/dstate.c, only used by the asynchronous serial transport */
+void dstate_set_io(int fd, const struct timeval *timer, void (*handler)(void)) { }
+void perf_io(double start) { }
+
 #ifdef HAVE_PTHREAD
 static pthread_mutex_t dev_mutex;
 #endif